@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+#include "BufferPool.hpp"
+#include "CuckooHashing.hpp"
+#include "DiskManager.hpp"
+#include "ExtendibleHashing.hpp"
+#include "InstrumentedScheme.hpp"
+#include "LinearHashing.hpp"
+#include "StaticHashing.hpp"
+
+/**
+ * @brief Benchmarks of the hashing schemes over a matrix of workloads
+ * Every combination of the listed schemes, key counts, key distributions, read percentages and page sizes is run,
+ * and reported as one CSV line or JSON object. Run with --help for the options.
+ */
+
+using Key = uint64_t;
+using Scheme = HashingScheme<Key, Key>;
+
+struct Options {
+    std::vector<std::string> schemes{"static", "extendible", "linear", "cuckoo"};
+    std::vector<uint64_t> key_counts{10000, 100000};
+    std::vector<std::string> distributions{"uniform", "zipf", "sequential"};
+    std::vector<uint64_t> read_percents{100, 95, 50};
+    std::vector<uint64_t> page_sizes{1024, 4096};
+    uint64_t num_ops{100000};
+    uint64_t memory_kib{4096};  // buffer pool size, the same for every page size
+    uint64_t seed{42};
+    bool json{false};
+    bool histograms{false};  // dump the latency histograms and I/O statistics of each workload to stderr
+    bool wal{false};  // commit through a write-ahead log
+    std::string file{(std::filesystem::temp_directory_path() / "bench.db").string()};
+};
+
+struct Workload {
+    std::string scheme;
+    uint64_t num_keys;
+    std::string distribution;
+    uint64_t read_percent;
+    uint64_t page_size;
+};
+
+struct Result {
+    double load_seconds;
+    double ops_per_sec;
+    uint64_t p50_ns, p99_ns, p999_ns;
+    double ios_per_op;  // page reads and writes reaching the disk
+    double hit_rate;
+};
+
+/**
+ * @brief Draws ranks in [0, n) with probability proportional to 1 / (rank + 1)^theta
+ */
+class ZipfGenerator {
+    std::vector<double> cdf;
+
+public:
+    explicit ZipfGenerator(uint64_t n, double theta = 0.99) : cdf(n) {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+            cdf[i] = sum;
+        }
+        for (auto &c: cdf) {
+            c /= sum;
+        }
+    }
+
+    template<typename Rng>
+    uint64_t operator()(Rng &rng) {
+        const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        return std::min<uint64_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), cdf.size() - 1);
+    }
+};
+
+/**
+ * @brief Check if the scheme can run with --wal, linear and cuckoo hashing log no redo records for their metadata
+ */
+bool supports_wal(const std::string &name) {
+    return name != "linear" && name != "cuckoo";
+}
+
+std::unique_ptr<Scheme> make_scheme(const std::string &name, BufferPool* bp, uint64_t num_keys) {
+    const uint64_t capacity = Bucket<Key, Key>::capacity_for(bp->get_page_size());
+    const uint64_t num_buckets = std::max<uint64_t>(1, num_keys / capacity);
+    if (name == "static") {
+        return std::make_unique<StaticHashing<Key, Key>>(num_buckets, bp);
+    }
+    if (name == "extendible") {
+        return std::make_unique<ExtendibleHashing<Key, Key>>(bp);
+    }
+    if (name == "linear") {
+        return std::make_unique<LinearHashing<Key, Key>>(bp);
+    }
+    if (name == "cuckoo") {
+        return std::make_unique<CuckooHashing<Key, Key>>(num_buckets, bp);
+    }
+    throw std::runtime_error("Unknown scheme: " + name);
+}
+
+/**
+ * @brief Keys of the operations, as indexes into the loaded keys
+ */
+std::vector<uint64_t> gen_accesses(const Workload &w, uint64_t num_ops, std::mt19937_64 &rng) {
+    std::vector<uint64_t> accesses(num_ops);
+    if (w.distribution == "uniform") {
+        std::uniform_int_distribution<uint64_t> dist(0, w.num_keys - 1);
+        std::generate(accesses.begin(), accesses.end(), [&] { return dist(rng); });
+    } else if (w.distribution == "zipf") {
+        // the hottest keys are spread over the key space, not the first ones loaded
+        std::vector<uint64_t> ranked(w.num_keys);
+        std::iota(ranked.begin(), ranked.end(), 0);
+        std::shuffle(ranked.begin(), ranked.end(), rng);
+        ZipfGenerator zipf(w.num_keys);
+        std::generate(accesses.begin(), accesses.end(), [&] { return ranked[zipf(rng)]; });
+    } else if (w.distribution == "sequential") {
+        for (uint64_t i = 0; i < num_ops; ++i) {
+            accesses[i] = i % w.num_keys;
+        }
+    } else {
+        throw std::runtime_error("Unknown distribution: " + w.distribution);
+    }
+    return accesses;
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    return sorted[std::min<size_t>(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+}
+
+/**
+ * @brief Load the keys into a fresh file, then time each operation of the workload
+ * Writes replace the value of an existing key, as a remove followed by an insert.
+ */
+Result run(const Workload &w, const Options &opt) {
+    using Clock = std::chrono::steady_clock;
+    std::filesystem::remove(opt.file);
+    std::filesystem::remove(opt.file + ".wal");
+    Result result{};
+    {
+        DiskManager dm(opt.file, w.page_size, IoMode::Buffered, opt.wal);
+        BufferPool bp(&dm, std::max<uint64_t>(8, opt.memory_kib * 1024 / w.page_size));
+        auto built = make_scheme(w.scheme, &bp, w.num_keys);
+        Scheme* scheme = built.get();
+        Instrumentation stats;
+        std::unique_ptr<InstrumentedScheme<Key, Key>> instrumented;
+        if (opt.histograms) {
+            instrumented = std::make_unique<InstrumentedScheme<Key, Key>>(scheme, &stats);
+            scheme = instrumented.get();
+            dm.io_stats.set_page_tracking(true);
+        }
+        std::mt19937_64 rng(opt.seed);
+
+        // keys are spread over the whole 64 bit range, not dense integers
+        std::vector<Key> keys(w.num_keys);
+        for (uint64_t i = 0; i < w.num_keys; ++i) {
+            keys[i] = i * 0x9E3779B97F4A7C15;
+        }
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < w.num_keys; ++i) {
+            scheme->insert(keys[i], i);
+        }
+        bp.sync();
+        result.load_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const auto accesses = gen_accesses(w, opt.num_ops, rng);
+        std::vector<bool> is_read(opt.num_ops);
+        std::uniform_int_distribution<uint64_t> percent(0, 99);
+        for (uint64_t i = 0; i < opt.num_ops; ++i) {
+            is_read[i] = percent(rng) < w.read_percent;
+        }
+        std::vector<uint64_t> latencies(opt.num_ops);
+        dm.reset_stats();
+        bp.reset_stats();
+        stats.reset();
+        Key value;
+        uint64_t found = 0;
+        start = Clock::now();
+        for (uint64_t i = 0; i < opt.num_ops; ++i) {
+            const auto op_start = Clock::now();
+            const Key key = keys[accesses[i]];
+            if (is_read[i]) {
+                found += scheme->get(key, &value);
+            } else {
+                found += scheme->remove(key);
+                scheme->insert(key, i);
+            }
+            latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - op_start).count();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        // count the writes which are still buffered, they are part of the cost of the workload
+        bp.sync();
+        if (found != opt.num_ops) {
+            throw std::runtime_error("Lost keys while running " + w.scheme);
+        }
+
+        if (opt.histograms) {
+            std::cerr << w.scheme << " keys=" << w.num_keys << " " << w.distribution << " reads=" << w.read_percent
+                      << "% page_size=" << w.page_size << "\n";
+            stats.dump(std::cerr);
+            std::cerr << "io: " << dm.io_stats.to_json() << "\n";
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        result.ops_per_sec = static_cast<double>(opt.num_ops) / seconds;
+        result.p50_ns = percentile(latencies, 0.5);
+        result.p99_ns = percentile(latencies, 0.99);
+        result.p999_ns = percentile(latencies, 0.999);
+        result.ios_per_op = static_cast<double>(dm.num_reads + dm.num_writes) / static_cast<double>(opt.num_ops);
+        const auto accesses_made = bp.num_hits + bp.num_misses;
+        result.hit_rate = accesses_made ? static_cast<double>(bp.num_hits) / static_cast<double>(accesses_made) : 0;
+    }
+    std::filesystem::remove(opt.file);
+    std::filesystem::remove(opt.file + ".wal");
+    return result;
+}
+
+template<typename T>
+std::vector<T> parse_list(std::string_view arg) {
+    std::vector<T> items;
+    while (!arg.empty()) {
+        const auto comma = arg.find(',');
+        const std::string item(arg.substr(0, comma));
+        if constexpr (std::is_same_v<T, std::string>) {
+            items.push_back(item);
+        } else {
+            items.push_back(std::stoull(item));
+        }
+        arg = comma == std::string_view::npos ? std::string_view() : arg.substr(comma + 1);
+    }
+    return items;
+}
+
+void print_usage() {
+    std::cout << "Usage: bench [options], lists are comma separated\n"
+                 "  --schemes LIST        static, extendible, linear, cuckoo\n"
+                 "  --keys LIST           number of keys loaded before the workload\n"
+                 "  --distributions LIST  uniform, zipf, sequential\n"
+                 "  --reads LIST          percentage of the operations which are lookups, the rest are updates\n"
+                 "  --page-sizes LIST     page sizes in bytes\n"
+                 "  --ops N               operations timed per workload\n"
+                 "  --memory KIB          buffer pool size\n"
+                 "  --seed N              seed of the generated workloads\n"
+                 "  --file PATH           scratch file, removed after each workload\n"
+                 "  --json                print a JSON array instead of CSV\n"
+                 "  --histograms          dump the latency histograms of each workload, splits and merges included,\n"
+                 "                        and its page I/O by operation and by page, to stderr\n"
+                 "  --wal                 commit the loaded keys and the workload through a write-ahead log, only\n"
+                 "                        static and extendible support it, the other schemes are skipped\n";
+}
+
+Options parse_options(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--json") {
+            opt.json = true;
+            continue;
+        }
+        if (arg == "--histograms") {
+            opt.histograms = true;
+            continue;
+        }
+        if (arg == "--wal") {
+            opt.wal = true;
+            continue;
+        }
+        if (arg == "--help" || i + 1 == argc) {
+            print_usage();
+            std::exit(arg == "--help" ? 0 : 1);
+        }
+        const std::string_view value = argv[++i];
+        if (arg == "--schemes") {
+            opt.schemes = parse_list<std::string>(value);
+        } else if (arg == "--keys") {
+            opt.key_counts = parse_list<uint64_t>(value);
+        } else if (arg == "--distributions") {
+            opt.distributions = parse_list<std::string>(value);
+        } else if (arg == "--reads") {
+            opt.read_percents = parse_list<uint64_t>(value);
+        } else if (arg == "--page-sizes") {
+            opt.page_sizes = parse_list<uint64_t>(value);
+        } else if (arg == "--ops") {
+            opt.num_ops = std::stoull(std::string(value));
+        } else if (arg == "--memory") {
+            opt.memory_kib = std::stoull(std::string(value));
+        } else if (arg == "--seed") {
+            opt.seed = std::stoull(std::string(value));
+        } else if (arg == "--file") {
+            opt.file = value;
+        } else {
+            print_usage();
+            std::exit(1);
+        }
+    }
+    return opt;
+}
+
+int main(int argc, char** argv) {
+    const Options opt = parse_options(argc, argv);
+    if (opt.json) {
+        fmt::print("[");
+    } else {
+        fmt::print("scheme,keys,distribution,read_percent,page_size,ops,load_s,ops_per_sec,p50_ns,p99_ns,p999_ns,"
+                   "ios_per_op,hit_rate\n");
+    }
+    bool first = true;
+    for (const auto &scheme: opt.schemes) {
+        if (opt.wal && !supports_wal(scheme)) {
+            std::cerr << "Skipping " << scheme << ", it doesn't support --wal\n";
+            continue;
+        }
+        for (const auto num_keys: opt.key_counts) {
+            for (const auto &distribution: opt.distributions) {
+                for (const auto read_percent: opt.read_percents) {
+                    for (const auto page_size: opt.page_sizes) {
+                        const Workload w{scheme, num_keys, distribution, read_percent, page_size};
+                        const Result r = run(w, opt);
+                        if (opt.json) {
+                            fmt::print("{}\n  {{\"scheme\": \"{}\", \"keys\": {}, \"distribution\": \"{}\", "
+                                       "\"read_percent\": {}, \"page_size\": {}, \"ops\": {}, \"load_s\": {:.4f}, "
+                                       "\"ops_per_sec\": {:.0f}, \"p50_ns\": {}, \"p99_ns\": {}, \"p999_ns\": {}, "
+                                       "\"ios_per_op\": {:.4f}, \"hit_rate\": {:.4f}}}",
+                                       first ? "" : ",", w.scheme, w.num_keys, w.distribution, w.read_percent,
+                                       w.page_size, opt.num_ops, r.load_seconds, r.ops_per_sec, r.p50_ns, r.p99_ns,
+                                       r.p999_ns, r.ios_per_op, r.hit_rate);
+                        } else {
+                            fmt::print("{},{},{},{},{},{},{:.4f},{:.0f},{},{},{},{:.4f},{:.4f}\n", w.scheme,
+                                       w.num_keys, w.distribution, w.read_percent, w.page_size, opt.num_ops,
+                                       r.load_seconds, r.ops_per_sec, r.p50_ns, r.p99_ns, r.p999_ns, r.ios_per_op,
+                                       r.hit_rate);
+                        }
+                        std::fflush(stdout);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    if (opt.json) {
+        fmt::print("\n]\n");
+    }
+    return 0;
+}
@@ -0,0 +1,359 @@
+#ifndef ASYNCDISKMANAGER_HPP
+#define ASYNCDISKMANAGER_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "common.h"
+#include "DiskManager.hpp"
+
+/**
+ * @brief DiskManager backend which keeps up to a fixed number of page reads and writes in flight at once
+ * Requests started with read_page_async/write_page_async are submitted to an io_uring, and completed by a thread
+ * reaping its completion queue. If the kernel doesn't support io_uring (5.11 or later, for timed waits), or it is
+ * disabled, a pool of threads doing pread/pwrite is used instead. The synchronous read_page/write_page still do a plain pread/pwrite.
+ */
+class AsyncDiskManager : public DiskManager {
+private:
+    struct Request {
+        IdT page_id;
+        iovec iov;  // buffer of the request, kept here as the kernel reads it after the submission
+        bool write;
+        std::promise<void> done;
+    };
+
+    static constexpr long REAP_TIMEOUT_NS = 100'000'000;  // longest wait of the reaper before checking if it is stopped
+
+    const uint32_t queue_depth;
+    std::mutex queue_latch;  // guards the fields below, and the submission queue of the ring
+    std::condition_variable queue_changed;  // notified when a request is queued or completed
+    uint32_t in_flight{0};
+    bool stopping{false};
+    std::deque<Request*> pending;  // requests waiting for a worker, only used without io_uring
+    std::vector<std::thread> threads;  // the reaper with io_uring, the workers otherwise
+
+    // io_uring state, ring_fd is -1 if it isn't used
+    int ring_fd{-1};
+    void* sq_ring{MAP_FAILED};
+    void* cq_ring{MAP_FAILED};
+    void* sqe_map{MAP_FAILED};
+    size_t sq_ring_size{0};
+    size_t cq_ring_size{0};
+    size_t sqe_map_size{0};
+    unsigned* sq_head{nullptr};
+    unsigned* sq_tail{nullptr};
+    unsigned sq_mask{0};
+    unsigned* sq_array{nullptr};
+    io_uring_sqe* sqes{nullptr};
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned cq_mask{0};
+    io_uring_cqe* cqes{nullptr};
+
+    /**
+     * @brief Create the ring and map its queues
+     * @return False if io_uring can't be used
+     */
+    bool setup_ring() {
+        io_uring_params params{};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring_fd < 0) {
+            // ENOSYS on kernels without io_uring, EPERM where it is disabled
+            ring_fd = -1;
+            return false;
+        }
+        if (!(params.features & IORING_FEAT_EXT_ARG)) {
+            // the reaper couldn't wait with a timeout, and could be left blocked if the stopping no-op isn't taken
+            close(ring_fd);
+            ring_fd = -1;
+            return false;
+        }
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_map) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_SQ_RING);
+        cq_ring = single_map ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqe_map_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqe_map = mmap(nullptr, sqe_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_SQES);
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_map == MAP_FAILED) {
+            teardown_ring();
+            return false;
+        }
+        char* sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqes = static_cast<io_uring_sqe*>(sqe_map);
+        char* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void teardown_ring() {
+        if (sqe_map != MAP_FAILED) {
+            munmap(sqe_map, sqe_map_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        sq_ring = cq_ring = sqe_map = MAP_FAILED;
+        close(ring_fd);
+        ring_fd = -1;
+    }
+
+    /**
+     * @brief Submit one entry to the ring, queue_latch must be held
+     * @param req Request to read or write, or nullptr for the no-op which stops the reaper
+     * @return False if the kernel didn't accept the entry, which is then withdrawn, so that nothing in the ring refers
+     * to the request anymore
+     */
+    bool push_sqe(uint8_t opcode, Request* req) {
+        const unsigned tail = *sq_tail;
+        const unsigned idx = tail & sq_mask;
+        io_uring_sqe &sqe = sqes[idx];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        if (req) {
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<uint64_t>(&req->iov);
+            sqe.len = 1;
+            sqe.off = req->page_id * page_size;
+        }
+        sqe.user_data = reinterpret_cast<uint64_t>(req);
+        sq_array[idx] = idx;
+        // publish the entry before the kernel can see the new tail
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        long ret;
+        do {
+            ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0);
+        } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+        if (ret == 1) {
+            return true;
+        }
+        // the kernel only consumes entries inside io_uring_enter, and the latch keeps other submitters out, so an
+        // entry it left in the queue can be withdrawn by moving the tail back
+        if (__atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == tail) {
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            return false;
+        }
+        // consumed after all, its completion comes through the ring
+        return true;
+    }
+
+    /**
+     * @brief Wait for a free slot in the queue, and hand the request to the ring or the workers
+     */
+    std::future<void> submit(IdT page_id, char* data, bool write) {
+        if (direct_io && !is_aligned(data)) {
+            throw std::runtime_error("Direct I/O needs page buffers aligned to " +
+                                     std::to_string(DIRECT_IO_ALIGNMENT));
+        }
+        auto req = std::make_unique<Request>(Request{page_id, {data, page_size}, write, {}});
+        auto done = req->done.get_future();
+        std::unique_lock lock(queue_latch);
+        queue_changed.wait(lock, [&] { return in_flight < queue_depth; });
+        if (ring_fd >= 0) {
+            if (!push_sqe(write ? IORING_OP_WRITEV : IORING_OP_READV, req.get())) {
+                // the ring didn't take the request, serve it on this thread like a worker would
+                ++in_flight;
+                lock.unlock();
+                serve(req.release());
+                return done;
+            }
+        } else {
+            pending.push_back(req.get());
+            queue_changed.notify_all();
+        }
+        ++in_flight;
+        // owned by the ring or the workers from now on
+        req.release();
+        return done;
+    }
+
+    /**
+     * @brief Finish a request with the number of bytes transferred, or a negated error number
+     */
+    void complete(Request* req, int64_t result) {
+        const std::unique_ptr<Request> owned(req);
+        if (result == static_cast<int64_t>(page_size)) {
+            owned->done.set_value();
+        } else {
+            owned->done.set_exception(std::make_exception_ptr(
+                    std::runtime_error(owned->write ? "Unable to write" : "Bad read")));
+        }
+        std::lock_guard guard(queue_latch);
+        --in_flight;
+        queue_changed.notify_all();
+    }
+
+    /**
+     * @brief Do the read or write of a request with pread/pwrite, and complete it
+     */
+    void serve(Request* req) {
+        const auto offset = static_cast<off_t>(req->page_id * page_size);
+        const ssize_t n = req->write ? pwrite(fd, req->iov.iov_base, page_size, offset)
+                                     : pread(fd, req->iov.iov_base, page_size, offset);
+        complete(req, n);
+    }
+
+    bool is_stopping() {
+        std::lock_guard guard(queue_latch);
+        return stopping;
+    }
+
+    /**
+     * @brief Complete the requests of the ring as they finish, till the stopping no-op comes through or it is stopped
+     * The waits time out, so that the reaper notices it was stopped even if the no-op couldn't be submitted.
+     */
+    void reap() {
+        __kernel_timespec timeout{0, REAP_TIMEOUT_NS};
+        io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        for (bool stop = false; !stop;) {
+            if (syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                        sizeof(arg)) < 0 && errno != EINTR && errno != ETIME) {
+                return;
+            }
+            unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe &cqe = cqes[head & cq_mask];
+                if (auto* req = reinterpret_cast<Request*>(cqe.user_data)) {
+                    complete(req, cqe.res);
+                } else {
+                    stop = true;
+                }
+            }
+            // hand the entries back to the kernel only once they have been read
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            stop = stop || is_stopping();
+        }
+    }
+
+    /**
+     * @brief Serve queued requests with pread/pwrite, till stopped and no requests are left
+     */
+    void work() {
+        for (;;) {
+            Request* req;
+            {
+                std::unique_lock lock(queue_latch);
+                queue_changed.wait(lock, [&] { return !pending.empty() || stopping; });
+                if (pending.empty()) {
+                    return;
+                }
+                req = pending.front();
+                pending.pop_front();
+            }
+            serve(req);
+        }
+    }
+
+    void wait_idle() {
+        std::unique_lock lock(queue_latch);
+        queue_changed.wait(lock, [&] { return in_flight == 0; });
+    }
+
+protected:
+    /**
+     * @brief Wait for the writes in flight before flushing, so that they are made durable too
+     */
+    void flush_file() override {
+        wait_idle();
+        DiskManager::flush_file();
+    }
+
+public:
+    /**
+     * @param queueDepth Maximum number of requests in flight, submitting more waits for one of them to finish
+     * @param useIoUring Use io_uring if the kernel supports it, otherwise always use the thread pool
+     * @param mode With IoMode::Direct, the buffers of the asynchronous requests must be aligned, as BufferPool frames are
+     */
+    explicit AsyncDiskManager(const std::string &file_name, uint32_t pageSize = PAGE_SIZE,
+                              uint32_t queueDepth = ASYNC_QUEUE_DEPTH, bool useIoUring = true,
+                              IoMode mode = IoMode::Buffered)
+            : DiskManager(file_name, pageSize, mode), queue_depth(std::max(queueDepth, 1u)) {
+        if (useIoUring && setup_ring()) {
+            threads.emplace_back(&AsyncDiskManager::reap, this);
+        } else {
+            for (uint32_t i = 0; i < queue_depth; ++i) {
+                threads.emplace_back(&AsyncDiskManager::work, this);
+            }
+        }
+    }
+
+    ~AsyncDiskManager() override {
+        {
+            std::unique_lock lock(queue_latch);
+            queue_changed.wait(lock, [&] { return in_flight == 0; });
+            stopping = true;
+            if (ring_fd >= 0) {
+                // wakes the reaper right away, without it the reaper notices the stop when its wait times out
+                push_sqe(IORING_OP_NOP, nullptr);
+            }
+            queue_changed.notify_all();
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        if (ring_fd >= 0) {
+            teardown_ring();
+        }
+    }
+
+    std::future<void> read_page_async(IdT page_id, char* page_data) override {
+        ++num_reads;
+        ++num_peeks;
+        io_stats.record_read(page_id, page_size);
+        return submit(page_id, page_data, false);
+    }
+
+    std::future<void> write_page_async(IdT page_id, const char* page_data) override {
+        ++num_writes;
+        io_stats.record_write(page_id, page_size);
+        auto done = submit(page_id, const_cast<char*>(page_data), true);
+        page_written();
+        return done;
+    }
+
+    bool overlaps_reads() const override {
+        return true;
+    }
+
+    bool uses_io_uring() const {
+        return ring_fd >= 0;
+    }
+
+    uint32_t get_queue_depth() const {
+        return queue_depth;
+    }
+};
+
+#endif //ASYNCDISKMANAGER_HPP
@@ -2,120 +2,528 @@
 #define BUCKET_HPP
 
 #include "common.h"
-#include "DiskManager.hpp"
+#include "BufferPool.hpp"
+#include "TagGroup.hpp"
 #include <unordered_map>
 #include <cereal/types/string.hpp>
 #include <cereal/types/unordered_map.hpp>
 #include <cereal/archives/binary.hpp>
+#include <algorithm>
+#include <bit>
 #include <cstring>
-#include <cinttypes>
+#include <functional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <type_traits>
+
+/**
+ * @brief Header at the start of every bucket page
+ * In the fixed layout it is followed by the tags of the keys, and then by `count` packed key/value slots.
+ * Otherwise it is followed by the serialized map.
+ */
+struct BucketHeader {
+    uint32_t count;  // number of entries in the page
+    uint32_t local_depth;
+    uint32_t free_offset;  // offset of the first unused byte in the page
+};
 
 template<typename K, typename V>
 class Bucket {
+    /**
+     * Trivially copyable entries are stored in fixed size slots which can be searched in place.
+     * Other types (like std::string) fall back to a cereal serialized map.
+     */
+    static constexpr bool fixed_layout = std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>;
+    static constexpr uint32_t slot_size = sizeof(K) + sizeof(V);
+
+    static constexpr uint32_t round_up_to_group(uint32_t n) {
+        return (n + TagGroup::WIDTH - 1) / TagGroup::WIDTH * TagGroup::WIDTH;
+    }
+
+    // occupancy of the page, cached from its header so that is_full/is_empty don't need to touch the page
+    uint32_t count{0};
+    uint32_t bytes_used{0};
+    bool header_cached{false};
+    // largest serialized entry inserted so far, used to estimate if the next one fits in the serialized layout
+    uint32_t max_entry_size{0};
+
 public:
+    /**
+     * @brief Number of entries that fit in a page of the given size, along with their tags in the fixed layout
+     * The tag array is padded to whole groups, so that the last group can be loaded at once.
+     * This is only an estimate for the serialized layout.
+     */
+    static constexpr uint32_t capacity_for(uint32_t page_size) {
+        if constexpr (fixed_layout) {
+            uint32_t n = (page_size - sizeof(BucketHeader)) / (slot_size + 1);
+            while (sizeof(BucketHeader) + round_up_to_group(n) + n * slot_size > page_size) {
+                --n;
+            }
+            return n;
+        } else {
+            return (page_size - sizeof(BucketHeader)) / slot_size;
+        }
+    }
+
     uint64_t page_id;
     uint64_t local_depth{0};
-    DiskManager* dm;
+    BufferPool* bp;
+    uint32_t page_size{bp->get_page_size()};  // taken from the DiskManager, so that pages are used in full
+    uint32_t capacity{capacity_for(page_size)};
 
-    explicit Bucket(DiskManager* dm) : dm(dm) {
-        page_id = dm->new_page();
+    explicit Bucket(BufferPool* bp) : bp(bp) {
+        page_id = bp->new_page();
         clear();
     }
 
-    explicit Bucket(DiskManager* dm, uint64_t pageId, uint64_t localDepth = 0) : dm(dm), page_id(pageId),
-                                                                                 local_depth(localDepth) {}
+    /**
+     * @brief Create a bucket on a new page, holding the given entries
+     */
+    explicit Bucket(BufferPool* bp, std::unordered_map<K, V> &&entries, uint64_t localDepth) : local_depth(localDepth),
+                                                                                               bp(bp) {
+        page_id = bp->new_page();
+        write_page(std::move(entries));
+    }
+
+    explicit Bucket(BufferPool* bp, uint64_t pageId, uint64_t localDepth = 0) : page_id(pageId),
+                                                                                local_depth(localDepth), bp(bp) {}
 
     bool find(const K &key, V* value) {
-        std::unordered_map<K, V> map = read_page();
-        auto it = map.find(key);
-        if (it != map.end()) {
-            *value = it->second;
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            cache_header(read_header(page.data()));
+            const auto slot = find_slot(page.data(), key);
+            if (slot < 0)
+                return false;
+            memcpy(value, page.data() + slot_offset(slot) + sizeof(K), sizeof(V));
             return true;
+        } else {
+            std::unordered_map<K, V> map = read_page();
+            auto it = map.find(key);
+            if (it != map.end()) {
+                *value = it->second;
+                return true;
+            }
+            return false;
         }
-        return false;
     }
 
     bool contains(const K &key) {
-        std::unordered_map<K, V> map = read_page();
-        return map.contains(key);
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            return find_slot(page.data(), key) >= 0;
+        } else {
+            std::unordered_map<K, V> map = read_page();
+            return map.contains(key);
+        }
     }
 
     bool insert(const K &key, const V &value) {
-        std::unordered_map<K, V> map = read_page();
-        if (map.contains(key))
-            return false;
-        map[key] = value;
-        write_page(std::move(map));
-        return true;
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            if (find_slot(page.data(), key) >= 0)
+                return false;
+            auto header = read_header(page.data());
+            if (header.count >= capacity) {
+                cache_header(header);
+                throw std::runtime_error("Bucket is full");
+            }
+            char* page_data = page.mutable_data();
+            // append the entry to the end of the packed slots
+            tags(page_data)[header.count] = key_tag(key);
+            memcpy(page_data + header.free_offset, &key, sizeof(K));
+            memcpy(page_data + header.free_offset + sizeof(K), &value, sizeof(V));
+            ++header.count;
+            header.free_offset += slot_size;
+            header.local_depth = local_depth;
+            write_header(page_data, header);
+            cache_header(header);
+            return true;
+        } else {
+            std::unordered_map<K, V> map = read_page();
+            if (map.contains(key))
+                return false;
+            map[key] = value;
+            const uint32_t old_bytes_used = bytes_used;
+            write_page(std::move(map));
+            max_entry_size = std::max(max_entry_size, bytes_used - old_bytes_used);
+            return true;
+        }
     }
 
     bool remove(const K &key) {
-        std::unordered_map<K, V> map = read_page();
-        if (!map.contains(key))
-            return false;
-        map.erase(key);
-        write_page(std::move(map));
-        return true;
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            const auto slot = find_slot(page.data(), key);
+            if (slot < 0)
+                return false;
+            char* page_data = page.mutable_data();
+            auto header = read_header(page_data);
+            // fill the hole with the last entry, so that the slots stay packed
+            --header.count;
+            header.free_offset -= slot_size;
+            if (slot != header.count) {
+                tags(page_data)[slot] = tags(page_data)[header.count];
+                memcpy(page_data + slot_offset(slot), page_data + header.free_offset, slot_size);
+            }
+            header.local_depth = local_depth;
+            write_header(page_data, header);
+            cache_header(header);
+            return true;
+        } else {
+            std::unordered_map<K, V> map = read_page();
+            if (!map.contains(key))
+                return false;
+            map.erase(key);
+            write_page(std::move(map));
+            return true;
+        }
+    }
+
+    /**
+     * @brief Look up several keys, pinning the page once
+     * @param idxs Positions of the keys to look up, values and found are written at the same positions
+     * @return Number of keys found
+     */
+    size_t find_batch(std::span<const K> keys, std::span<const size_t> idxs, std::span<V> values,
+                      std::vector<bool> &found) {
+        size_t num_found = 0;
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            cache_header(read_header(page.data()));
+            for (const auto i: idxs) {
+                const auto slot = find_slot(page.data(), keys[i]);
+                if (slot >= 0) {
+                    memcpy(&values[i], page.data() + slot_offset(slot) + sizeof(K), sizeof(V));
+                    found[i] = true;
+                    ++num_found;
+                }
+            }
+        } else {
+            const std::unordered_map<K, V> map = read_page();
+            for (const auto i: idxs) {
+                auto it = map.find(keys[i]);
+                if (it != map.end()) {
+                    values[i] = it->second;
+                    found[i] = true;
+                    ++num_found;
+                }
+            }
+        }
+        return num_found;
+    }
+
+    /**
+     * @brief Insert several entries, pinning and writing the page once, till the bucket is full
+     * Keys which are already present are skipped.
+     * @param idxs Positions of the entries to insert
+     * @param[out] num_inserted Incremented for every entry inserted
+     * @return Number of positions processed, the entries after them didn't fit
+     */
+    size_t insert_batch(std::span<const K> keys, std::span<const V> values, std::span<const size_t> idxs,
+                        size_t &num_inserted) {
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            auto header = read_header(page.data());
+            size_t processed = 0;
+            for (; processed < idxs.size(); ++processed) {
+                const auto i = idxs[processed];
+                if (find_slot(page.data(), keys[i]) >= 0)
+                    continue;
+                if (header.count >= capacity)
+                    break;
+                char* page_data = page.mutable_data();
+                tags(page_data)[header.count] = key_tag(keys[i]);
+                memcpy(page_data + header.free_offset, &keys[i], sizeof(K));
+                memcpy(page_data + header.free_offset + sizeof(K), &values[i], sizeof(V));
+                ++header.count;
+                header.free_offset += slot_size;
+                // keep the header current, find_slot reads the count from the page
+                header.local_depth = local_depth;
+                write_header(page_data, header);
+                ++num_inserted;
+            }
+            cache_header(header);
+            return processed;
+        } else {
+            // the size of serialized entries isn't known up front, so add them one by one
+            size_t processed = 0;
+            for (; processed < idxs.size(); ++processed) {
+                const auto i = idxs[processed];
+                if (contains(keys[i]))
+                    continue;
+                if (is_full(keys[i], values[i]))
+                    break;
+                num_inserted += insert(keys[i], values[i]);
+            }
+            return processed;
+        }
     }
 
+    /**
+     * @brief Remove several keys, pinning and writing the page once
+     * @param idxs Positions of the keys to remove, found is set at the positions of the removed ones
+     * @return Number of keys removed
+     */
+    size_t remove_batch(std::span<const K> keys, std::span<const size_t> idxs, std::vector<bool> &found) {
+        size_t num_removed = 0;
+        if constexpr (fixed_layout) {
+            PageGuard page(bp, page_id);
+            for (const auto i: idxs) {
+                const auto slot = find_slot(page.data(), keys[i]);
+                if (slot < 0)
+                    continue;
+                char* page_data = page.mutable_data();
+                auto header = read_header(page_data);
+                --header.count;
+                header.free_offset -= slot_size;
+                if (slot != header.count) {
+                    tags(page_data)[slot] = tags(page_data)[header.count];
+                    memcpy(page_data + slot_offset(slot), page_data + header.free_offset, slot_size);
+                }
+                header.local_depth = local_depth;
+                write_header(page_data, header);
+                cache_header(header);
+                found[i] = true;
+                ++num_removed;
+            }
+        } else {
+            std::unordered_map<K, V> map = read_page();
+            for (const auto i: idxs) {
+                if (map.erase(keys[i])) {
+                    found[i] = true;
+                    ++num_removed;
+                }
+            }
+            if (num_removed) {
+                write_page(std::move(map));
+            }
+        }
+        return num_removed;
+    }
+
+    /**
+     * @brief Check if there is no space for another entry, without any page I/O once the header is cached
+     * For the serialized layout this is an estimate based on the largest entry inserted till now, use the overload
+     * taking the entry to know if a given one fits.
+     */
     bool is_full() {
-        int peek_size = 16;  // number of bytes to peek
-        char* data;
-        size_t size;  // bytes taken by the serialized form of map (actual data size)
-        size_t size_len;  // number of bytes used by 'size' variable serialization itself
-        char next_char;  // the character immediately to the right of the last digit of 'size'
-        do {
-            data = new char[peek_size];
-            char* end = nullptr;  // points to the character just after the 'size'
-            dm->peek_page(page_id, peek_size, data);
-            size = strtoull(data, &end, 10);
-            next_char = *end;
-            peek_size *= 2;
-            size_len = end - data;
-            delete[] data;
-            // according to format, the size is followed by a space. In case we didn't hit a space, this means the number of
-            // bytes taken up by 'size' itself, is more than what we peeked. So we retry after doubling the peek_size
-        } while (next_char != ' ');
-        // end points to the end of the size variable
-        const uint8_t extra = sizeof(K) + sizeof(V); // space used by one entry in the bucket
-        return size_len + size + extra >= PAGE_SIZE;
+        load_header();
+        if constexpr (fixed_layout) {
+            return count >= capacity;
+        } else {
+            return bytes_used + std::max(max_entry_size, slot_size) > page_size;
+        }
+    }
+
+    /**
+     * @brief Check if there is no space for the given entry, which is exact for both layouts
+     */
+    bool is_full(const K &key, const V &value) {
+        load_header();
+        if constexpr (fixed_layout) {
+            return count >= capacity;
+        } else {
+            return bytes_used + entry_size(key, value) > page_size;
+        }
+    }
+
+    /**
+     * @brief Check if the entry fits in an empty page of the given size, so that making room for it is ever possible
+     */
+    static bool fits_empty_page(uint32_t page_size, const K &key, const V &value) {
+        if constexpr (fixed_layout) {
+            return capacity_for(page_size) > 0;
+        } else {
+            static const uint32_t empty_map_size = [] {
+                std::ostringstream ss(std::stringstream::out | std::stringstream::binary);
+                {
+                    cereal::BinaryOutputArchive archive(ss);
+                    archive(std::unordered_map<K, V>{});
+                }
+                return static_cast<uint32_t>(ss.tellp());
+            }();
+            return sizeof(BucketHeader) + empty_map_size + entry_size(key, value) <= page_size;
+        }
+    }
+
+    /**
+     * @brief Bytes taken by the entry in the serialized layout, on top of the map it is added to
+     */
+    static uint32_t entry_size(const K &key, const V &value) {
+        std::ostringstream ss(std::stringstream::out | std::stringstream::binary);
+        {
+            cereal::BinaryOutputArchive archive(ss);
+            // maps are serialized as their size followed by each key and value
+            archive(key, value);
+        }
+        return static_cast<uint32_t>(ss.tellp());
     }
 
     bool is_empty() {
-        const auto map = read_page();
-        return map.empty();
+        load_header();
+        return count == 0;
     }
 
     void clear() {
         write_page({});
     }
 
+    /**
+     * @brief Get a copy of all the entries in the bucket
+     */
     std::unordered_map<K, V> read_page() {
-        char page_data[PAGE_SIZE];
-        dm->read_page(page_id, page_data);
-        std::istringstream ss(std::stringstream::in | std::stringstream::binary);
-        char* end;
-        std::streamsize size = strtol(page_data, &end, 10);
-        ss.rdbuf()->pubsetbuf(end + 1, size);
-        cereal::BinaryInputArchive archive(ss);
+        PageGuard page(bp, page_id);
+        const auto header = read_header(page.data());
+        cache_header(header);
         std::unordered_map<K, V> map;
-        archive(map);
+        if constexpr (fixed_layout) {
+            map.reserve(header.count);
+            for (uint32_t i = 0; i < header.count; ++i) {
+                K key;
+                V value;
+                memcpy(&key, page.data() + slot_offset(i), sizeof(K));
+                memcpy(&value, page.data() + slot_offset(i) + sizeof(K), sizeof(V));
+                map.emplace(key, value);
+            }
+        } else {
+            std::istringstream ss(std::stringstream::in | std::stringstream::binary);
+            char* start = const_cast<char*>(page.data()) + sizeof(BucketHeader);
+            ss.rdbuf()->pubsetbuf(start, header.free_offset - sizeof(BucketHeader));
+            cereal::BinaryInputArchive archive(ss);
+            archive(map);
+        }
         return map;
     }
 
-private:
+    /**
+     * @brief Replace all the entries in the bucket, writing the page once
+     */
     void write_page(std::unordered_map<K, V> &&map) {
-        char page_data[PAGE_SIZE];
-        std::ostringstream ss(std::stringstream::out | std::stringstream::binary);
-        cereal::BinaryOutputArchive archive(ss);
+        if constexpr (fixed_layout) {
+            const BucketHeader header{static_cast<uint32_t>(map.size()), static_cast<uint32_t>(local_depth),
+                                      slot_offset(map.size())};
+            if (header.count > capacity) {
+                throw std::runtime_error("Bucket is full");
+            }
+            PageGuard page(bp, page_id);
+            char* page_data = page.mutable_data();
+            write_header(page_data, header);
+            uint32_t i = 0;
+            for (auto &[key, value]: map) {
+                tags(page_data)[i] = key_tag(key);
+                memcpy(page_data + slot_offset(i), &key, sizeof(K));
+                memcpy(page_data + slot_offset(i) + sizeof(K), &value, sizeof(V));
+                ++i;
+            }
+            cache_header(header);
+        } else {
+            std::ostringstream ss(std::stringstream::out | std::stringstream::binary);
+            cereal::BinaryOutputArchive archive(ss);
+
+            archive(map);
+            auto s = ss.str();
+            const BucketHeader header{static_cast<uint32_t>(map.size()), static_cast<uint32_t>(local_depth),
+                                      static_cast<uint32_t>(sizeof(BucketHeader) + s.size())};
+            if (header.free_offset > page_size) {
+                throw std::runtime_error("Bucket is full");
+            }
+            PageGuard page(bp, page_id);
+            char* page_data = page.mutable_data();
+            write_header(page_data, header);
+            memcpy(page_data + sizeof(BucketHeader), s.data(), s.size());
+            cache_header(header);
+        }
+    }
+
+    /**
+     * @brief Replace the entries in the bucket with as many of the given entries as fit in it
+     * The entries that are moved to the bucket are removed from the map.
+     */
+    void fill(std::unordered_map<K, V> &entries) {
+        if constexpr (fixed_layout) {
+            std::unordered_map<K, V> chunk;
+            while (!entries.empty() && chunk.size() < capacity) {
+                chunk.insert(entries.extract(entries.begin()));
+            }
+            write_page(std::move(chunk));
+        } else {
+            // the size of serialized entries isn't known up front, so add them one by one
+            clear();
+            while (!entries.empty() && !is_full(entries.begin()->first, entries.begin()->second)) {
+                auto entry = entries.extract(entries.begin());
+                insert(entry.key(), entry.mapped());
+            }
+        }
+    }
+private:
+    void cache_header(const BucketHeader &header) {
+        count = header.count;
+        bytes_used = header.free_offset;
+        header_cached = true;
+    }
 
-        archive(map);
-        auto s = ss.str();
-        auto size = static_cast<std::streamsize>(s.size());
-        int start = sprintf(page_data, "%" PRId64 " ", size);
-        memcpy(page_data + start, s.c_str(), size);
-        dm->write_page(page_id, page_data);
+    void load_header() {
+        if (!header_cached) {
+            PageGuard page(bp, page_id);
+            cache_header(read_header(page.data()));
+        }
+    }
+
+    static BucketHeader read_header(const char* page_data) {
+        BucketHeader header{};
+        memcpy(&header, page_data, sizeof(BucketHeader));
+        return header;
+    }
+
+    static void write_header(char* page_data, const BucketHeader &header) {
+        memcpy(page_data, &header, sizeof(BucketHeader));
+    }
+
+    uint32_t slot_offset(uint32_t slot) const {
+        return sizeof(BucketHeader) + round_up_to_group(capacity) + slot * slot_size;
+    }
+
+    static int8_t* tags(char* page_data) {
+        return reinterpret_cast<int8_t*>(page_data + sizeof(BucketHeader));
     }
+
+    static const int8_t* tags(const char* page_data) {
+        return reinterpret_cast<const int8_t*>(page_data + sizeof(BucketHeader));
+    }
+
+    static int8_t key_tag(const K &key) {
+        return TagGroup::tag(TagGroup::mix(std::hash<K>{}(key)));
+    }
+
+    /**
+     * @brief Search the packed slots of the page for the key
+     * The tags are compared a group at a time, and only the keys with a matching tag are compared.
+     * @return Index of the slot containing the key, or -1 if absent
+     */
+    int64_t find_slot(const char* page_data, const K &key) const {
+        const auto header = read_header(page_data);
+        const int8_t tag = key_tag(key);
+        for (uint32_t group = 0; group * TagGroup::WIDTH < header.count; ++group) {
+            const uint32_t start = group * TagGroup::WIDTH;
+            uint32_t mask = TagGroup::match(tags(page_data) + start, tag);
+            if (header.count - start < TagGroup::WIDTH) {
+                // ignore the stale tags after the last slot
+                mask &= (1u << (header.count - start)) - 1;
+            }
+            for (; mask; mask &= mask - 1) {
+                const uint32_t i = start + std::countr_zero(mask);
+                K slot_key;
+                memcpy(&slot_key, page_data + slot_offset(i), sizeof(K));
+                if (slot_key == key)
+                    return i;
+            }
+        }
+        return -1;
+    }
+
 };
 
 
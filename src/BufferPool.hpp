@@ -0,0 +1,393 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+#include "DiskManager.hpp"
+
+/**
+ * @brief Keeps a fixed number of pages in memory on top of a DiskManager
+ * Pages are pinned while they are being used, and only unpinned pages can be evicted (least recently used first).
+ * Dirty pages are written back to the disk when evicted or flushed.
+ * If the DiskManager maps pages in memory (MmapDiskManager), the pool hands out the mapped pages directly instead.
+ * All the operations are thread-safe. Pages are read from the disk without holding the latch of the pool,
+ * other threads fetching the same page wait for the read to finish.
+ */
+class BufferPool {
+private:
+    struct Frame {
+        IdT page_id{};
+        uint32_t pin_count{0};
+        bool dirty{false};
+        bool loading{false};  // the page is being read from the disk by the thread which pinned it first
+        std::list<size_t>::iterator lru_pos;  // position in the LRU list, only valid if the frame is unpinned
+    };
+
+    DiskManager* dm;
+    const uint32_t page_size;
+    const bool zero_copy;  // pages are accessed in place through DiskManager::map_page
+    AlignedBuffer data;  // contents of all the frames, frame `i` starts at `i * page_size`, aligned for direct I/O
+    std::vector<Frame> frames;
+    std::unordered_map<IdT, size_t> page_table;  // page_id -> index of the frame holding it
+    std::list<size_t> lru;  // unpinned frames, least recently used at the front
+    std::vector<size_t> free_frames;  // frames not holding any page
+    std::mutex latch;  // guards all of the above, except the contents of pinned frames
+    std::atomic<uint64_t> unsynced_writes{0};  // pages written back since the last sync()
+    std::condition_variable loaded;  // notified when a frame has finished loading
+
+    char* frame_data(size_t frame_idx) {
+        return data.get() + frame_idx * page_size;
+    }
+
+    void pin(size_t frame_idx) {
+        auto &frame = frames[frame_idx];
+        if (frame.pin_count++ == 0) {
+            lru.erase(frame.lru_pos);
+        }
+    }
+
+    /**
+     * @brief Release one pin on the frame, the latch must be held
+     */
+    void unpin(size_t frame_idx, bool is_dirty) {
+        auto &frame = frames[frame_idx];
+        frame.dirty |= is_dirty;
+        if (--frame.pin_count == 0) {
+            frame.lru_pos = lru.insert(lru.end(), frame_idx);
+        }
+    }
+
+    void write_back(size_t frame_idx) {
+        auto &frame = frames[frame_idx];
+        if (frame.dirty) {
+            dm->write_page(frame.page_id, frame_data(frame_idx));
+            frame.dirty = false;
+            ++unsynced_writes;
+        }
+    }
+
+    /**
+     * @brief Find a frame that can hold a new page, evicting the least recently used page if needed
+     * @return Index of the frame, which is not present in the page table or the LRU list
+     */
+    size_t get_free_frame() {
+        if (!free_frames.empty()) {
+            const size_t frame_idx = free_frames.back();
+            free_frames.pop_back();
+            return frame_idx;
+        }
+        if (lru.empty()) {
+            throw std::runtime_error("All frames are pinned");
+        }
+        const size_t frame_idx = lru.front();
+        lru.pop_front();
+        write_back(frame_idx);
+        page_table.erase(frames[frame_idx].page_id);
+        ++num_evictions;
+        return frame_idx;
+    }
+
+    /**
+     * @brief Map the page to a frame, with a pin count of 1
+     */
+    size_t install(IdT page_id, size_t frame_idx) {
+        auto &frame = frames[frame_idx];
+        frame.page_id = page_id;
+        frame.pin_count = 1;
+        frame.dirty = false;
+        page_table[page_id] = frame_idx;
+        return frame_idx;
+    }
+
+public:
+    std::atomic<uint64_t> num_hits{};
+    std::atomic<uint64_t> num_misses{};
+    std::atomic<uint64_t> num_evictions{};
+    std::atomic<uint64_t> num_writes{};  // pages modified by the callers, whether or not they have reached the disk yet
+    std::atomic<uint64_t> num_prefetches{};  // pages read ahead of being fetched
+
+    explicit BufferPool(DiskManager* dm, size_t numFrames = BUFFER_POOL_FRAMES)
+            : dm(dm), page_size(dm->get_page_size()), zero_copy(dm->maps_pages()),
+              data(make_aligned_buffer(zero_copy ? 0 : numFrames * page_size)), frames(zero_copy ? 0 : numFrames) {
+        free_frames.reserve(frames.size());
+        for (size_t i = frames.size(); i > 0; --i) {
+            free_frames.push_back(i - 1);
+        }
+    }
+
+    BufferPool(const BufferPool &) = delete;
+
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    ~BufferPool() {
+        flush_all();
+    }
+
+    DiskManager* get_disk_manager() const {
+        return dm;
+    }
+
+    uint32_t get_page_size() const {
+        return page_size;
+    }
+
+    /**
+     * @brief Allocate a new page on the disk and keep a zero-filled copy of it in the pool
+     * The page is marked dirty, so it reaches the disk even if it is never written to by the caller.
+     * @return ID of the new page, which is not pinned
+     */
+    IdT new_page() {
+        if (zero_copy) {
+            const IdT page_id = dm->new_page();
+            std::fill_n(dm->map_page(page_id), page_size, 0);
+            return page_id;
+        }
+        std::lock_guard guard(latch);
+        // take the frame first, so that no page is allocated on the disk if all the frames are pinned
+        const size_t free_frame = get_free_frame();
+        IdT page_id;
+        try {
+            page_id = dm->new_page();
+        } catch (...) {
+            free_frames.push_back(free_frame);
+            throw;
+        }
+        const size_t frame_idx = install(page_id, free_frame);
+        std::fill_n(frame_data(frame_idx), page_size, 0);
+        unpin(frame_idx, true);
+        return page_id;
+    }
+
+    /**
+     * @brief Get a pinned, in-memory copy of the page, reading it from the disk if it isn't cached
+     * Every call must be paired with a call to unpin_page
+     * @return Pointer to page_size bytes of page data, valid till the page is unpinned
+     */
+    char* fetch_page(IdT page_id) {
+        if (zero_copy) {
+            ++num_hits;
+            return dm->map_page(page_id);
+        }
+        std::unique_lock lock(latch);
+        auto it = page_table.find(page_id);
+        while (it != page_table.end() && frames[it->second].loading) {
+            // the frame may be reused for another page if the read fails, so look the page up again
+            loaded.wait(lock);
+            it = page_table.find(page_id);
+        }
+        if (it != page_table.end()) {
+            ++num_hits;
+            pin(it->second);
+            return frame_data(it->second);
+        }
+        ++num_misses;
+        const size_t frame_idx = install(page_id, get_free_frame());
+        frames[frame_idx].loading = true;
+        lock.unlock();
+        try {
+            dm->read_page(page_id, frame_data(frame_idx));
+        } catch (...) {
+            lock.lock();
+            frames[frame_idx].loading = false;
+            frames[frame_idx].pin_count = 0;
+            page_table.erase(page_id);
+            free_frames.push_back(frame_idx);
+            loaded.notify_all();
+            throw;
+        }
+        lock.lock();
+        frames[frame_idx].loading = false;
+        loaded.notify_all();
+        return frame_data(frame_idx);
+    }
+
+    /**
+     * @brief Read the pages which aren't cached yet, starting all the reads before waiting for any of them
+     * This only pays off if the DiskManager overlaps reads, otherwise nothing is done. Pages are only read into
+     * frames which are free or unpinned, and a failed read is left to be retried by the next fetch of the page.
+     */
+    void prefetch(std::span<const IdT> page_ids) {
+        if (zero_copy || !dm->overlaps_reads()) {
+            return;
+        }
+        std::vector<size_t> loading;
+        std::unique_lock lock(latch);
+        for (const auto page_id: page_ids) {
+            if (page_table.contains(page_id)) {
+                continue;
+            }
+            if (free_frames.empty() && lru.empty()) {
+                break;
+            }
+            const size_t frame_idx = install(page_id, get_free_frame());
+            frames[frame_idx].loading = true;
+            loading.push_back(frame_idx);
+        }
+        lock.unlock();
+
+        std::vector<std::future<void>> reads;
+        reads.reserve(loading.size());
+        for (const auto frame_idx: loading) {
+            try {
+                reads.push_back(dm->read_page_async(frames[frame_idx].page_id, frame_data(frame_idx)));
+            } catch (...) {
+                std::promise<void> failed;
+                failed.set_exception(std::current_exception());
+                reads.push_back(failed.get_future());
+            }
+        }
+        std::vector<bool> ok(loading.size());
+        for (size_t i = 0; i < reads.size(); ++i) {
+            try {
+                reads[i].get();
+                ok[i] = true;
+            } catch (...) {
+            }
+        }
+
+        lock.lock();
+        for (size_t i = 0; i < loading.size(); ++i) {
+            auto &frame = frames[loading[i]];
+            frame.loading = false;
+            if (ok[i]) {
+                ++num_prefetches;
+                unpin(loading[i], false);
+            } else {
+                frame.pin_count = 0;
+                page_table.erase(frame.page_id);
+                free_frames.push_back(loading[i]);
+            }
+        }
+        loaded.notify_all();
+    }
+
+    /**
+     * @brief Release one pin on the page
+     * @param is_dirty Whether the caller modified the page data
+     */
+    void unpin_page(IdT page_id, bool is_dirty) {
+        num_writes += is_dirty;
+        if (zero_copy) {
+            return;
+        }
+        std::lock_guard guard(latch);
+        auto it = page_table.find(page_id);
+        if (it == page_table.end() || frames[it->second].pin_count == 0) {
+            throw std::runtime_error("Page is not pinned");
+        }
+        unpin(it->second, is_dirty);
+    }
+
+    /**
+     * @brief Drop the page from the pool without writing it back, and free it on the disk
+     */
+    void delete_page(IdT page_id) {
+        {
+            std::lock_guard guard(latch);
+            auto it = page_table.find(page_id);
+            if (it != page_table.end()) {
+                auto &frame = frames[it->second];
+                if (frame.pin_count) {
+                    throw std::runtime_error("Can't delete a pinned page");
+                }
+                lru.erase(frame.lru_pos);
+                free_frames.push_back(it->second);
+                page_table.erase(it);
+            }
+        }
+        dm->remove_page(page_id);
+    }
+
+    void flush_page(IdT page_id) {
+        std::lock_guard guard(latch);
+        auto it = page_table.find(page_id);
+        if (it != page_table.end()) {
+            write_back(it->second);
+        }
+    }
+
+    void flush_all() {
+        std::lock_guard guard(latch);
+        for (auto &[page_id, frame_idx]: page_table) {
+            write_back(frame_idx);
+        }
+    }
+
+    /**
+     * @brief Write back all dirty pages and make them durable
+     */
+    void sync() {
+        flush_all();
+        dm->sync();
+        unsynced_writes = 0;
+    }
+
+    /**
+     * @brief Check if the batch of the write-ahead log took WAL_MAX_BATCH_PAGES page write-backs since the last sync()
+     */
+    bool is_batch_full() const {
+        return unsynced_writes >= WAL_MAX_BATCH_PAGES && dm->has_write_ahead_log();
+    }
+
+    /**
+     * @brief Called by the schemes after each of their operations, which is where the batch of a write-ahead log can be
+     * committed without committing part of an operation
+     * With a log, nothing reaches the file before a commit, and the batch holds the image of every page written back
+     * till then. So once it is full, it is committed here, keeping its memory bounded even if sync() is never called.
+     * The caller must make sure that no other operation is running.
+     */
+    void end_operation() {
+        if (is_batch_full()) {
+            sync();
+        }
+    }
+
+    void reset_stats() {
+        num_hits = num_misses = num_evictions = num_writes = num_prefetches = 0;
+    }
+};
+
+/**
+ * @brief Keeps a page pinned for the lifetime of the guard
+ */
+class PageGuard {
+private:
+    BufferPool* bp;
+    IdT page_id;
+    char* page_data;
+    bool dirty{false};
+
+public:
+    PageGuard(BufferPool* bp, IdT page_id) : bp(bp), page_id(page_id), page_data(bp->fetch_page(page_id)) {}
+
+    PageGuard(const PageGuard &) = delete;
+
+    PageGuard &operator=(const PageGuard &) = delete;
+
+    ~PageGuard() {
+        bp->unpin_page(page_id, dirty);
+    }
+
+    const char* data() const {
+        return page_data;
+    }
+
+    /**
+     * @brief Get the page data for modification, the page will be written back when evicted
+     */
+    char* mutable_data() {
+        dirty = true;
+        return page_data;
+    }
+};
+
+#endif //BUFFERPOOL_HPP
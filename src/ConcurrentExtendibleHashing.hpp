@@ -0,0 +1,169 @@
+#ifndef CONCURRENTEXTENDIBLEHASHING_HPP
+#define CONCURRENTEXTENDIBLEHASHING_HPP
+
+#include "common.h"
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+#include "Bucket.hpp"
+#include "BufferPool.hpp"
+#include "ExtendibleHashing.hpp"
+
+/**
+ * @brief Extendible hashing which can be used from multiple threads at once
+ * The directory is guarded by a reader/writer latch, and each bucket by a latch picked from a fixed set by its page.
+ * Operations crab from the directory to the bucket: the bucket latch is taken while holding the directory latch in
+ * shared mode, after which the directory latch is released. A split which doesn't double the directory keeps the
+ * directory latch shared along with the bucket latch, and only holds the slot latch exclusively while pointing the
+ * directory entries of the bucket to its new sibling. Splits which double the directory and merges take the directory
+ * latch exclusively, and then drain the operations still working on buckets by taking every bucket latch.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
+class ConcurrentExtendibleHashing : public ExtendibleHashing<K, V, Hash> {
+    using Base = ExtendibleHashing<K, V, Hash>;
+    static constexpr size_t NUM_BUCKET_LATCHES = 64;
+
+    std::shared_mutex dir_latch;
+    // guards the directory entries while the directory latch is only held in shared mode, taken after a bucket latch
+    std::shared_mutex slot_latch;
+    std::array<std::mutex, NUM_BUCKET_LATCHES> bucket_latches;
+
+    std::mutex &bucket_latch(const Bucket<K, V> &bucket) {
+        return bucket_latches[bucket.page_id % NUM_BUCKET_LATCHES];
+    }
+
+    std::shared_ptr<Bucket<K, V>> lookup(const K &key) {
+        std::shared_lock slots(slot_latch);
+        return this->buckets[this->get_bucket_idx(key)];
+    }
+
+    /**
+     * @brief Find the bucket of the key and latch it, the directory latch must be held in shared mode
+     * The bucket could be split between looking it up and latching it, so its directory entry is checked again once
+     * the latch is held, after which the bucket stays the one of the key.
+     */
+    std::pair<std::shared_ptr<Bucket<K, V>>, std::unique_lock<std::mutex>> latch_bucket(const K &key) {
+        while (true) {
+            auto bucket = lookup(key);
+            std::unique_lock guard(bucket_latch(*bucket));
+            if (lookup(key) == bucket) {
+                return {std::move(bucket), std::move(guard)};
+            }
+        }
+    }
+
+    /**
+     * @brief Wait for all the operations on buckets to finish, the directory latch must be held exclusively
+     * @return Locks on all the bucket latches, no bucket can be accessed by other threads till they are released
+     */
+    std::vector<std::unique_lock<std::mutex>> drain() {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(NUM_BUCKET_LATCHES);
+        for (auto &latch: bucket_latches) {
+            locks.emplace_back(latch);
+        }
+        return locks;
+    }
+
+    /**
+     * @brief Let the buffer pool commit the batch of the write-ahead log once it is full, after waiting for all the
+     * running operations, so that none of them is committed in part
+     */
+    void end_operation() {
+        if (this->bp->is_batch_full()) {
+            std::unique_lock dir(dir_latch);
+            auto drained = drain();
+            this->bp->end_operation();
+        }
+    }
+
+public:
+    explicit ConcurrentExtendibleHashing(BufferPool* bp, Hash hash_fn = Hash{})
+            : Base(bp, std::move(hash_fn)) {}
+
+    /**
+     * @brief Persist the directory, waiting for all the running operations first
+     */
+    void save() {
+        std::unique_lock dir(dir_latch);
+        auto drained = drain();
+        Base::save();
+    }
+
+    bool insert(const K &key, const V &value) override {
+        while (true) {
+            std::shared_lock dir(dir_latch);
+            auto [bucket, guard] = latch_bucket(key);
+            if (!bucket->is_full(key, value)) {
+                // the bucket can't be split or merged while its latch is held, so the directory can be released
+                dir.unlock();
+                const bool inserted = bucket->insert(key, value);
+                guard.unlock();
+                end_operation();
+                return inserted;
+            }
+            if (bucket->is_empty() || bucket->local_depth == this->global_depth) {
+                // the directory has to be doubled
+                break;
+            }
+            // destroyed before the slot latch is released, as the histograms aren't shared between threads
+            std::unique_lock slots(slot_latch, std::defer_lock);
+            const OpTimer timer(this->instrumentation, Op::Split);
+            // the sibling is written before any directory entry points to it, so nobody can see it half done
+            auto sibling = this->split(*bucket, key);
+            slots.lock();
+            this->link_sibling(key, sibling);
+            // look the bucket of the key up again, it might be the sibling or still be full
+        }
+        std::unique_lock dir(dir_latch);
+        auto drained = drain();
+        return Base::insert(key, value);
+    }
+
+    bool get(const K &key, V* value) override {
+        std::shared_lock dir(dir_latch);
+        auto [bucket, guard] = latch_bucket(key);
+        dir.unlock();
+        return bucket->find(key, value);
+    }
+
+    bool remove(const K &key) override {
+        {
+            std::shared_lock dir(dir_latch);
+            auto [bucket, guard] = latch_bucket(key);
+            dir.unlock();
+            if (!bucket->remove(key)) {
+                return false;
+            }
+            if (!bucket->local_depth || !bucket->is_empty()) {
+                guard.unlock();
+                end_operation();
+                return true;
+            }
+        }
+        // the bucket might be merged with its sibling
+        std::unique_lock dir(dir_latch);
+        auto drained = drain();
+        // the directory could have changed while no latch was held, so look the bucket up again
+        this->merge(this->get_bucket_idx(key));
+        this->bp->end_operation();
+        return true;
+    }
+
+    // the batched operations of ExtendibleHashing take no latches, so go through the latched single key ones
+    size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) override {
+        return HashingScheme<K, V>::multi_get(keys, values, found);
+    }
+
+    size_t multi_insert(std::span<const K> keys, std::span<const V> values) override {
+        return HashingScheme<K, V>::multi_insert(keys, values);
+    }
+
+    size_t multi_remove(std::span<const K> keys) override {
+        return HashingScheme<K, V>::multi_remove(keys);
+    }
+};
+
+#endif //CONCURRENTEXTENDIBLEHASHING_HPP
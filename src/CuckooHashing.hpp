@@ -0,0 +1,267 @@
+#ifndef CUCKOOHASHING_HPP
+#define CUCKOOHASHING_HPP
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "Bucket.hpp"
+#include "BufferPool.hpp"
+#include "Hashes.hpp"
+#include "HashingScheme.hpp"
+#include "PageChain.hpp"
+
+/**
+ * @brief Cuckoo hashing over bucket pages, with a stash page for entries which can't be placed
+ * Every key can only live in one of NUM_CHOICES buckets, picked by independent hash functions, or in the stash.
+ * So a lookup reads at most NUM_CHOICES pages, plus the stash page if it holds any entries.
+ * When both buckets of a new key are full, an entry is kicked out to make room, and moved to its other bucket,
+ * which may kick out another entry and so on. Chains longer than MAX_KICKS end in the stash, and once the stash
+ * is full as well, the table is rehashed into twice the number of buckets with new hash functions.
+ * @tparam Hash Hash function, called directly so that it can be inlined. Use HashFunction<K> to pick one at runtime.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
+class CuckooHashing : public HashingScheme<K, V> {
+    using HashFn = Hash;  // hash function type
+    static constexpr uint64_t SCHEME_MAGIC = 0x0048534148435543;  // "CUCHASH"
+    static constexpr uint32_t NUM_CHOICES = 2;  // number of buckets each key can be placed in
+public:
+    static constexpr uint32_t MAX_KICKS = 32;  // longest kick chain before falling back to the stash
+
+private:
+    uint64_t seed{0};  // picks the hash functions, changed by every rehash
+    uint64_t num_entries{0};
+    std::vector<Bucket<K, V>> buckets;
+    std::optional<Bucket<K, V>> stash;  // set up by the constructor or load()
+    BufferPool* bp;
+    [[no_unique_address]] HashFn hash_fn;
+    PageChain meta;  // persisted copy of the table
+
+    /**
+     * @brief Get the buckets the key can be placed in
+     * The hash functions are derived from hash_fn by mixing its output with a different constant for each one.
+     */
+    std::array<uint64_t, NUM_CHOICES> get_choices(const K &key) const {
+        const uint64_t hashed = hash_fn(key);
+        std::array<uint64_t, NUM_CHOICES> choices{};
+        for (uint32_t i = 0; i < NUM_CHOICES; ++i) {
+            // murmur3 finalizer, so that every bit of the hash affects the bucket
+            choices[i] = Hashes::fmix64(hashed ^ ((seed * NUM_CHOICES + i + 1) * 0x9E3779B97F4A7C15)) % buckets.size();
+        }
+        return choices;
+    }
+
+    bool contains(const K &key) {
+        for (auto idx: get_choices(key)) {
+            if (buckets[idx].contains(key))
+                return true;
+        }
+        return !stash->is_empty() && stash->contains(key);
+    }
+
+    void allocate(uint64_t num_buckets) {
+        buckets.clear();
+        buckets.reserve(num_buckets);
+        for (uint64_t i = 0; i < num_buckets; ++i) {
+            buckets.emplace_back(bp);
+        }
+    }
+
+    /**
+     * @brief Try to place an entry, kicking out other entries if needed
+     * @param[in,out] key, value The entry to place, replaced by the entry left without a bucket if this fails
+     * @return False if some entry could neither be placed in a bucket nor in the stash
+     */
+    bool try_place(K &key, V &value) {
+        auto choices = get_choices(key);
+        for (auto idx: choices) {
+            if (!buckets[idx].is_full(key, value)) {
+                buckets[idx].insert(key, value);
+                ++kick_chains[0];
+                return true;
+            }
+        }
+        uint64_t idx = choices[0];
+        for (uint32_t kicks = 1; kicks <= MAX_KICKS; ++kicks) {
+            // swap the entry with one from the full bucket, varying the victim so that chains don't cycle
+            auto entries = buckets[idx].read_page();
+            if (entries.empty()) {
+                break;
+            }
+            auto victim = std::next(entries.begin(), kicks % entries.size());
+            buckets[idx].remove(victim->first);
+            if (buckets[idx].is_full(key, value)) {
+                // a serialized entry can be larger than the victim, put it back and end the chain
+                buckets[idx].insert(victim->first, victim->second);
+                break;
+            }
+            buckets[idx].insert(key, value);
+            key = victim->first;
+            value = victim->second;
+            // move the victim to the next of its buckets
+            choices = get_choices(key);
+            const auto pos = std::find(choices.begin(), choices.end(), idx) - choices.begin();
+            idx = choices[(pos + 1) % NUM_CHOICES];
+            if (!buckets[idx].is_full(key, value)) {
+                buckets[idx].insert(key, value);
+                ++kick_chains[kicks];
+                return true;
+            }
+        }
+        if (!stash->is_full(key, value)) {
+            stash->insert(key, value);
+            ++num_stashed;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Place an entry which isn't in the table yet, rehashing till it can be placed
+     */
+    void place(K key, V value) {
+        while (!try_place(key, value)) {
+            rehash();
+        }
+    }
+
+    /**
+     * @brief Move all the entries to twice the number of buckets, using new hash functions
+     */
+    void rehash() {
+        const OpTimer timer(this->instrumentation, Op::Grow);
+        ++num_rehashes;
+        auto entries = stash->read_page();
+        stash->clear();
+        for (auto &bucket: buckets) {
+            entries.merge(bucket.read_page());
+            bp->delete_page(bucket.page_id);
+        }
+        ++seed;
+        allocate(buckets.size() * 2);
+        for (auto &[key, value]: entries) {
+            place(key, value);
+        }
+    }
+
+    /**
+     * @brief Rebuild the table from its persisted copy, without reading any bucket pages
+     */
+    void load() {
+        const auto words = meta.read();
+        if (words.size() < 4 || words[0] != SCHEME_MAGIC) {
+            throw std::runtime_error("File does not hold a cuckoo hashing scheme");
+        }
+        seed = words[1];
+        num_entries = words[2];
+        stash.emplace(bp, words[3]);
+        buckets.clear();
+        buckets.reserve(words.size() - 4);
+        for (size_t pos = 4; pos < words.size(); ++pos) {
+            buckets.emplace_back(bp, words[pos]);
+        }
+    }
+
+public:
+    // number of entries placed after each length of kick chain, a chain of length 0 found a free bucket right away
+    std::array<uint64_t, MAX_KICKS + 1> kick_chains{};
+    uint64_t num_stashed{};  // entries placed in the stash after MAX_KICKS kicks
+    uint64_t num_rehashes{};
+
+    /**
+     * @brief Create an empty table, or reopen the one stored in the file
+     * The file can't have a write-ahead log, as rehashes and the stash change the table without logging redo records.
+     * @param numBuckets Initial number of buckets for a new table, it doubles on every rehash
+     */
+    explicit CuckooHashing(uint64_t numBuckets, BufferPool* bp, HashFn hash_fn = HashFn{})
+            : bp(bp), hash_fn(std::move(hash_fn)), meta(bp, bp->get_disk_manager()->get_root_page()) {
+        if (bp->get_disk_manager()->has_write_ahead_log()) {
+            throw std::runtime_error("Cuckoo hashing doesn't support the write-ahead log");
+        }
+        if (meta.get_head()) {
+            load();
+            return;
+        }
+        meta = PageChain(bp);
+        bp->get_disk_manager()->set_root_page(meta.get_head());
+        stash.emplace(bp);
+        allocate(std::max<uint64_t>(numBuckets, 1));
+    }
+
+    ~CuckooHashing() override {
+        save();
+    }
+
+    /**
+     * @brief Persist the table, so that it can be reopened from the file
+     */
+    void save() {
+        std::vector<uint64_t> words{SCHEME_MAGIC, seed, num_entries, stash->page_id};
+        for (auto &bucket: buckets) {
+            words.push_back(bucket.page_id);
+        }
+        meta.write(words);
+    }
+
+    uint64_t get_num_buckets() const {
+        return buckets.size();
+    }
+
+    /**
+     * @brief Get the length of the longest kick chain that placed an entry
+     */
+    uint32_t max_kick_chain() const {
+        for (uint32_t kicks = MAX_KICKS; kicks > 0; --kicks) {
+            if (kick_chains[kicks]) {
+                return kicks;
+            }
+        }
+        return 0;
+    }
+
+    void reset_stats() {
+        kick_chains.fill(0);
+        num_stashed = num_rehashes = 0;
+    }
+
+    bool insert(const K &key, const V &value) override {
+        if (contains(key)) {
+            return false;
+        }
+        if (!Bucket<K, V>::fits_empty_page(bp->get_page_size(), key, value)) {
+            // no number of kicks or rehashes would make room for it
+            throw std::runtime_error("Entry does not fit in a page");
+        }
+        place(key, value);
+        ++num_entries;
+        return true;
+    }
+
+    bool get(const K &key, V* value) override {
+        for (auto idx: get_choices(key)) {
+            if (buckets[idx].find(key, value))
+                return true;
+        }
+        // the stash occupancy is cached, so it is only read if it holds some entries
+        return !stash->is_empty() && stash->find(key, value);
+    }
+
+    bool remove(const K &key) override {
+        for (auto idx: get_choices(key)) {
+            if (buckets[idx].remove(key)) {
+                --num_entries;
+                return true;
+            }
+        }
+        if (!stash->is_empty() && stash->remove(key)) {
+            --num_entries;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif //CUCKOOHASHING_HPP
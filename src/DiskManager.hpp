@@ -1,55 +1,477 @@
 #ifndef DISKMANAGER_HPP
 #define DISKMANAGER_HPP
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
-#include <unordered_set>
+#include <set>
+#include <span>
 #include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "common.h"
+#include "IoStats.hpp"
+#include "WriteAheadLog.hpp"
 
+/**
+ * @brief Group commit policy, deciding when written pages are flushed to the file without an explicit sync()
+ * A limit of 0 disables it, so by default durability is entirely up to the caller. It is not applied with a
+ * write-ahead log, where a flush in the middle of an operation of the scheme would commit only part of it, and
+ * BufferPool::end_operation() bounds the batch instead.
+ */
+struct SyncPolicy {
+    uint64_t max_pending_writes{0};  // flush once this many page writes are pending
+    std::chrono::microseconds max_delay{0};  // flush once the oldest pending write is older than this
+};
+
+/**
+ * @brief How the database file is accessed
+ * Direct I/O bypasses the page cache of the kernel, so that pages are only cached by the BufferPool. It needs the
+ * page size to be a multiple of DIRECT_IO_ALIGNMENT, and a file system which supports O_DIRECT.
+ */
+enum class IoMode {
+    Buffered,
+    Direct,
+};
+
+struct AlignedDeleter {
+    void operator()(char* p) const {
+        std::free(p);
+    }
+};
+
+/**
+ * @brief Zero-filled heap buffer aligned to DIRECT_IO_ALIGNMENT, so that it can be used for direct I/O
+ */
+using AlignedBuffer = std::unique_ptr<char[], AlignedDeleter>;
+
+inline AlignedBuffer make_aligned_buffer(size_t size) {
+    // aligned_alloc needs the size to be a multiple of the alignment
+    const size_t rounded = std::max<size_t>((size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT, 1) *
+                           DIRECT_IO_ALIGNMENT;
+    auto* p = static_cast<char*>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, rounded));
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    memset(p, 0, rounded);
+    return AlignedBuffer(p);
+}
+
+inline bool is_aligned(const void* p) {
+    return reinterpret_cast<uintptr_t>(p) % DIRECT_IO_ALIGNMENT == 0;
+}
+
+/**
+ * @brief Metadata kept in the first page of the database file
+ */
+struct Superblock {
+    uint64_t magic;
+    uint32_t page_size;
+    IdT last_used_page;
+    IdT root_page;  // first page of the metadata of the hashing scheme stored in the file, 0 if there is none
+    IdT free_head;  // first page of the chain of free pages, 0 if there is none
+    uint64_t num_free_pages;
+};
+
+/**
+ * @brief Allocates pages in a database file and moves them between the file and memory
+ * The first page of the file holds the Superblock, so a DiskManager can be reopened on an existing file.
+ * Freed pages form a linked chain on the disk, each one storing the ID of the next free page in its first bytes.
+ * This class does its I/O with pread/pwrite, other backends override read_bytes/write_bytes/flush_file.
+ * With IoMode::Direct, reads of partial pages and unaligned buffers go through an aligned bounce buffer.
+ * Page I/O does not depend on a shared file position, and the page bookkeeping is guarded by a latch,
+ * so a DiskManager can be used from multiple threads.
+ *
+ * With a write-ahead log, nothing reaches the file before it is committed: page writes, the free chain and the
+ * superblock are kept in the log's batch, and sync() commits the batch with a single flush of the log before writing
+ * its pages to the file, which is then only flushed by checkpoints. The hashing scheme logs redo records for the
+ * changes to its metadata between saves, and replays them when it is reopened. The batch must only be committed
+ * between operations of the scheme, once the buffer pool wrote back its pages, as BufferPool::sync() does. The schemes
+ * call BufferPool::end_operation() after each operation, which commits the batch once it grew large.
+ */
 class DiskManager {
 private:
+    static constexpr uint64_t SUPERBLOCK_MAGIC = 0x4853414844424B52;  // "RKDBHASH"
+
+    SyncPolicy sync_policy;
+    uint64_t pending_writes{0};  // page writes since the last flush
+    std::chrono::steady_clock::time_point first_pending_write;
+    bool superblock_dirty{false};
+    std::unique_ptr<WriteAheadLog> wal;
+    std::vector<std::vector<uint64_t>> redo_records;  // logged since the scheme last saved its metadata
+
+protected:
+    std::mutex latch;  // guards the page bookkeeping, the superblock and the pending writes
+    int fd{-1};
     const std::string file_name;
-    std::fstream db_file;
     const uint32_t page_size;
-    IdT last_used_page;
-    std::unordered_set<IdT> unused_pages;
+    const bool direct_io;
+    IdT last_used_page{0};  // page 0 is the superblock
+    IdT free_head{0};
+    uint64_t num_free_pages{0};
+    IdT root_page{0};
+
+    /**
+     * @brief Only set up the page bookkeeping, for backends that access the file on their own
+     * Such backends must call load_superblock once the file is accessible, and save_superblock before closing it.
+     */
+    DiskManager(const std::string &file_name, uint32_t pageSize, bool openFile, IoMode mode = IoMode::Buffered,
+                bool writeAheadLog = false)
+            : file_name(file_name), page_size(pageSize), direct_io(mode == IoMode::Direct) {
+        if (direct_io && page_size % DIRECT_IO_ALIGNMENT) {
+            throw std::runtime_error("Direct I/O needs the page size to be a multiple of " +
+                                     std::to_string(DIRECT_IO_ALIGNMENT));
+        }
+        if (openFile) {
+            open();
+            if (writeAheadLog) {
+                recover();
+            }
+            load_superblock();
+        }
+    }
+
+    /**
+     * @brief Read n bytes from the start of the page
+     */
+    virtual void read_bytes(IdT page_id, size_t n, char* data) {
+        const auto offset = static_cast<off_t>(page_id * page_size);
+        if (direct_io && (n != page_size || !is_aligned(data))) {
+            auto buffer = make_aligned_buffer(page_size);
+            if (pread(fd, buffer.get(), page_size, offset) != static_cast<ssize_t>(page_size)) {
+                throw std::runtime_error("Bad read");
+            }
+            memcpy(data, buffer.get(), n);
+            return;
+        }
+        if (pread(fd, data, n, offset) != static_cast<ssize_t>(n)) {
+            throw std::runtime_error("Bad read");
+        }
+    }
+
+    /**
+     * @brief Write a whole page
+     */
+    virtual void write_bytes(IdT page_id, const char* page_data) {
+        const auto offset = static_cast<off_t>(page_id * page_size);
+        if (direct_io && !is_aligned(page_data)) {
+            auto buffer = make_aligned_buffer(page_size);
+            memcpy(buffer.get(), page_data, page_size);
+            DiskManager::write_bytes(page_id, buffer.get());
+            return;
+        }
+        if (pwrite(fd, page_data, page_size, offset) != static_cast<ssize_t>(page_size)) {
+            throw std::runtime_error("Unable to write");
+        }
+    }
+
+    /**
+     * @brief Make all the page writes done so far durable, called by sync()
+     */
+    virtual void flush_file() {
+        if (fdatasync(fd) != 0) {
+            throw std::runtime_error("Unable to flush");
+        }
+    }
+
+    virtual uint64_t file_size() {
+        struct stat st{};
+        fstat(fd, &st);
+        return st.st_size;
+    }
+
+    /**
+     * @brief Cut the file down to the given size
+     */
+    virtual void truncate_file(uint64_t size) {
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Unable to truncate file");
+        }
+    }
+
+    /**
+     * @brief Write a whole page, or add it to the batch of the log if there is one, the latch must be held
+     */
+    void store_page(IdT page_id, const char* page_data) {
+        if (wal) {
+            wal->log_page(page_id, page_data);
+            return;
+        }
+        write_bytes(page_id, page_data);
+    }
+
+    /**
+     * @brief Read n bytes from the start of the page, as last stored, the latch must be held
+     */
+    void load_bytes(IdT page_id, size_t n, char* data) {
+        if (const char* image = wal ? wal->find_page(page_id) : nullptr) {
+            memcpy(data, image, n);
+            return;
+        }
+        read_bytes(page_id, n, data);
+    }
+
+    /**
+     * @brief Store the link to the next page of the free chain in a free page
+     */
+    void write_free_link(IdT page_id, IdT next_page) {
+        std::vector<char> page_data(page_size);
+        memcpy(page_data.data(), &next_page, sizeof(IdT));
+        store_page(page_id, page_data.data());
+    }
+
+    IdT read_free_link(IdT page_id) {
+        IdT next_page;
+        load_bytes(page_id, sizeof(IdT), reinterpret_cast<char*>(&next_page));
+        return next_page;
+    }
+
+    /**
+     * @brief Open the log of the file, and bring the file up to date with the batches committed to it
+     * The pages are written again even if they made it to the file before, as their images are complete. The log is
+     * then started over, keeping only the redo records which the scheme has to replay.
+     */
+    void recover() {
+        wal = std::make_unique<WriteAheadLog>(file_name + ".wal", page_size);
+        auto recovered = wal->recover();
+        for (const auto &[page_id, image]: recovered.pages) {
+            write_bytes(page_id, image.data());
+        }
+        if (!recovered.pages.empty()) {
+            flush_file();
+        }
+        redo_records = std::move(recovered.redo);
+        wal->reset(redo_records);
+    }
+
+    /**
+     * @brief Make the batch durable in the log, then write its pages to the file, the latch must be held
+     */
+    void commit() {
+        wal->commit();
+        for (const auto &[page_id, image]: wal->pending_pages()) {
+            write_bytes(page_id, image.data());
+        }
+        wal->clear_pending();
+        if (wal->size() >= WAL_CHECKPOINT_SIZE) {
+            checkpoint_log();
+        }
+    }
+
+    /**
+     * @brief Flush the file, after which the committed pages are not needed in the log anymore
+     */
+    void checkpoint_log() {
+        flush_file();
+        wal->reset(redo_records);
+    }
+
+    /**
+     * @brief Restore the page bookkeeping from the superblock, or set up a new one for an empty file
+     */
+    void load_superblock() {
+        if (file_size() < page_size) {
+            superblock_dirty = true;
+            save_superblock();
+            return;
+        }
+        Superblock superblock{};
+        load_bytes(0, sizeof(Superblock), reinterpret_cast<char*>(&superblock));
+        if (superblock.magic != SUPERBLOCK_MAGIC) {
+            throw std::runtime_error("Not a database file");
+        }
+        if (superblock.page_size != page_size) {
+            throw std::runtime_error("Page size mismatch");
+        }
+        last_used_page = superblock.last_used_page;
+        root_page = superblock.root_page;
+        free_head = superblock.free_head;
+        num_free_pages = superblock.num_free_pages;
+    }
+
+    void save_superblock() {
+        if (!superblock_dirty) {
+            return;
+        }
+        std::vector<char> page_data(page_size);
+        const Superblock superblock{SUPERBLOCK_MAGIC, page_size, last_used_page, root_page, free_head,
+                                    num_free_pages};
+        memcpy(page_data.data(), &superblock, sizeof(Superblock));
+        store_page(0, page_data.data());
+        superblock_dirty = false;
+    }
+
+    /**
+     * @brief Account for a page write, and flush if the sync policy asks for it
+     * Pending writes are only checked here, so the time limit is enforced when the next write happens.
+     */
+    void page_written() {
+        std::lock_guard guard(latch);
+        if (pending_writes++ == 0) {
+            first_pending_write = std::chrono::steady_clock::now();
+        }
+        if (sync_policy.max_pending_writes && pending_writes >= sync_policy.max_pending_writes) {
+            flush_pending();
+        } else if (sync_policy.max_delay.count() &&
+                   std::chrono::steady_clock::now() - first_pending_write >= sync_policy.max_delay) {
+            flush_pending();
+        }
+    }
+
+    /**
+     * @brief Flush the pending writes and the superblock, the latch must be held
+     */
+    void flush_pending() {
+        if (!pending_writes && !superblock_dirty && !maps_pages() && !(wal && wal->has_pending())) {
+            return;
+        }
+        save_superblock();
+        ++num_flushes;
+        pending_writes = 0;
+        if (wal) {
+            commit();
+            return;
+        }
+        flush_file();
+    }
+
+    /**
+     * @brief Open the file, creating it if it doesn't exist
+     */
+    void open() {
+        fd = ::open(file_name.c_str(), O_RDWR | O_CREAT | (direct_io ? O_DIRECT : 0), 0644);
+        if (fd < 0 && direct_io && errno == EINVAL) {
+            throw std::runtime_error("File system does not support direct I/O");
+        }
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file");
+        }
+    }
 
 public:
-    uint64_t num_reads{};
-    uint64_t num_peeks{};
-    uint64_t num_writes{};
-
-    explicit DiskManager(const std::string &file_name, uint32_t pageSize = PAGE_SIZE, IdT lastUsedPage = -1,
-                         std::unordered_set<IdT> unusedPages = {})
-            : file_name(file_name), page_size(pageSize), last_used_page(lastUsedPage),
-              unused_pages(std::move(unusedPages)) {
-        db_file.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
-        if (!db_file.is_open()) {
-            // create empty file
-            db_file.open(file_name, std::ios::trunc | std::ios::out | std::ios::binary);
-            db_file.close();
-            // reopen with original mode
-            db_file.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
-        }
-    }
-
-    IdT new_page() {
-        if (unused_pages.empty()) {
+    std::atomic<uint64_t> num_reads{};
+    std::atomic<uint64_t> num_peeks{};
+    std::atomic<uint64_t> num_writes{};
+    std::atomic<uint64_t> num_flushes{};
+    IoStats io_stats;  // reads and writes by operation and by page
+
+    /**
+     * @param writeAheadLog Commit changes through a log kept next to the file, recovering the file from it first
+     */
+    explicit DiskManager(const std::string &file_name, uint32_t pageSize = PAGE_SIZE, IoMode mode = IoMode::Buffered,
+                         bool writeAheadLog = false)
+            : DiskManager(file_name, pageSize, true, mode, writeAheadLog) {}
+
+    DiskManager(const DiskManager &) = delete;
+
+    DiskManager &operator=(const DiskManager &) = delete;
+
+    virtual ~DiskManager() {
+        if (fd >= 0) {
+            if (wal) {
+                // nothing of the batch is in the file yet
+                std::lock_guard guard(latch);
+                flush_pending();
+            } else {
+                save_superblock();
+            }
+            close(fd);
+        }
+    }
+
+    uint32_t get_page_size() const {
+        return page_size;
+    }
+
+    /**
+     * @brief Get the page where the hashing scheme stored in this file keeps its metadata
+     * @return Page ID, or 0 if no scheme has been stored yet
+     */
+    IdT get_root_page() {
+        std::lock_guard guard(latch);
+        return root_page;
+    }
+
+    void set_root_page(IdT page_id) {
+        std::lock_guard guard(latch);
+        root_page = page_id;
+        superblock_dirty = true;
+    }
+
+    /**
+     * @brief Allocate a page, reusing the most recently freed page if there is one
+     */
+    virtual IdT new_page() {
+        std::lock_guard guard(latch);
+        superblock_dirty = true;
+        if (!free_head) {
             return ++last_used_page;
-        } else {
-            IdT page_id = *unused_pages.begin();
-            unused_pages.erase(unused_pages.begin());
-            return page_id;
         }
+        const IdT page_id = free_head;
+        free_head = read_free_link(page_id);
+        --num_free_pages;
+        return page_id;
     }
 
+    /**
+     * @brief Free a page, by pushing it to the front of the free chain
+     */
     void remove_page(IdT page_id) {
+        std::lock_guard guard(latch);
+        superblock_dirty = true;
         if (page_id == last_used_page) {
             --last_used_page;
-        } else {
-            unused_pages.insert(page_id);
+            return;
+        }
+        write_free_link(page_id, free_head);
+        free_head = page_id;
+        ++num_free_pages;
+    }
+
+    uint64_t get_num_free_pages() {
+        std::lock_guard guard(latch);
+        return num_free_pages;
+    }
+
+    /**
+     * @brief Give the free pages at the end of the file back to the filesystem
+     * This walks and relinks the whole free chain, so it is meant to be run occasionally.
+     */
+    void compact() {
+        std::lock_guard guard(latch);
+        std::set<IdT> free_pages;
+        for (IdT page_id = free_head; page_id; page_id = read_free_link(page_id)) {
+            free_pages.insert(page_id);
+        }
+        while (!free_pages.empty() && *free_pages.rbegin() == last_used_page) {
+            free_pages.erase(last_used_page--);
         }
+        // relink the remaining pages, in ascending order so that allocations fill up the start of the file first
+        free_head = 0;
+        for (auto it = free_pages.rbegin(); it != free_pages.rend(); ++it) {
+            write_free_link(*it, free_head);
+            free_head = *it;
+        }
+        num_free_pages = free_pages.size();
+        superblock_dirty = true;
+        save_superblock();
+        if (wal) {
+            // the cut pages must not be brought back by recovery, nor the old free chain point to them
+            flush_pending();
+            checkpoint_log();
+        }
+        truncate_file((last_used_page + 1) * page_size);
     }
 
     /**
@@ -73,31 +495,144 @@ public:
         if (n > page_size) {
             return;
         }
-        const auto offset = page_id * page_size;
-        db_file.seekg(offset);
-        db_file.read(data, n);
-        if (db_file.fail()) {
-            throw std::runtime_error("Bad read");
+        io_stats.record_read(page_id, n);
+        if (wal) {
+            // pages which are not in the batch are read without the latch, commits write the file before clearing it
+            std::lock_guard guard(latch);
+            if (const char* image = wal->find_page(page_id)) {
+                memcpy(data, image, n);
+                return;
+            }
         }
+        read_bytes(page_id, n, data);
     }
 
     void write_page(IdT page_id, const char* page_data) {
         ++num_writes;
-        const auto offset = page_id * page_size;
-        db_file.clear();
-        db_file.seekp(offset);
-        if (db_file.fail()) {
-            throw std::runtime_error("Unable to seek");
+        io_stats.record_write(page_id, page_size);
+        if (wal) {
+            std::lock_guard guard(latch);
+            store_page(page_id, page_data);
+            return;
         }
-        db_file.write(page_data, page_size);
-        db_file.flush();
-        if (db_file.fail()) {
-            throw std::runtime_error("Unable to seek");
+        write_bytes(page_id, page_data);
+        page_written();
+    }
+
+    /**
+     * @brief Start reading a whole page, the future becomes ready once page_data holds it
+     * This backend reads synchronously, AsyncDiskManager keeps several reads in flight at once.
+     */
+    virtual std::future<void> read_page_async(IdT page_id, char* page_data) {
+        std::promise<void> done;
+        try {
+            read_page(page_id, page_data);
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+        return done.get_future();
+    }
+
+    /**
+     * @brief Start writing a whole page, page_data must stay valid till the future is ready
+     */
+    virtual std::future<void> write_page_async(IdT page_id, const char* page_data) {
+        std::promise<void> done;
+        try {
+            write_page(page_id, page_data);
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+        return done.get_future();
+    }
+
+    /**
+     * @brief Whether reads started with read_page_async overlap, so that issuing them together pays off
+     */
+    virtual bool overlaps_reads() const {
+        return false;
+    }
+
+    /**
+     * @brief Flush all pending page writes to the file, along with the superblock
+     * Pages modified in place through map_page are not tracked, so backends which map pages always flush.
+     */
+    void sync() {
+        std::lock_guard guard(latch);
+        flush_pending();
+    }
+
+    void set_sync_policy(SyncPolicy policy) {
+        std::lock_guard guard(latch);
+        sync_policy = policy;
+    }
+
+    /**
+     * @brief Sync, then flush the file so that the log can be started over
+     * Checkpoints also happen on their own once the log reaches WAL_CHECKPOINT_SIZE.
+     */
+    void checkpoint() {
+        std::lock_guard guard(latch);
+        flush_pending();
+        if (wal) {
+            checkpoint_log();
         }
     }
 
+    bool has_write_ahead_log() const {
+        return wal != nullptr;
+    }
+
+    /**
+     * @brief Log a change to the metadata of the scheme, which is committed along with the pages written before the
+     * next sync. Does nothing without a write-ahead log.
+     */
+    void log_redo(std::span<const uint64_t> record) {
+        if (!wal) {
+            return;
+        }
+        std::lock_guard guard(latch);
+        wal->log_redo(record);
+        redo_records.emplace_back(record.begin(), record.end());
+    }
+
+    /**
+     * @brief Drop the redo records logged so far, once the scheme saved the metadata they change
+     */
+    void clear_redo() {
+        if (!wal) {
+            return;
+        }
+        std::lock_guard guard(latch);
+        wal->log_clear_redo();
+        redo_records.clear();
+    }
+
+    /**
+     * @brief Get the redo records for the scheme to replay on top of its saved metadata when it is opened
+     */
+    std::vector<std::vector<uint64_t>> get_redo_records() {
+        std::lock_guard guard(latch);
+        return redo_records;
+    }
+
+    /**
+     * @brief Get direct access to the page, for backends which keep the file mapped in memory
+     * @return Pointer to page_size bytes of the page, or nullptr if the backend needs pages to be copied
+     */
+    virtual char* map_page(IdT /*page_id*/) {
+        return nullptr;
+    }
+
+    virtual bool maps_pages() const {
+        return false;
+    }
+
     void reset_stats() {
-        num_reads = num_peeks = num_writes = 0;
+        num_reads = num_peeks = num_writes = num_flushes = 0;
+        io_stats.reset();
     }
 };
 
@@ -2,43 +2,85 @@
 #define EXTENDIBLEHASHING_HPP
 
 #include "common.h"
+#include <algorithm>
+#include <array>
 #include <bitset>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 #include <functional>
 #include "Bucket.hpp"
+#include "Hashes.hpp"
 #include "HashingScheme.hpp"
-#include "DiskManager.hpp"
+#include "BufferPool.hpp"
+#include "PageChain.hpp"
+#include <numeric>
 #include <ranges>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
 
-template<typename K, typename V>
+/**
+ * @tparam Hash Hash function, called directly so that it can be inlined. Use HashFunction<K> to pick one at runtime.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
 class ExtendibleHashing : public HashingScheme<K, V> {
-    using HashFn = std::function<uint64_t(K)>;  // hash function type
-    DiskManager* dm;
-    HashFn hash_fn;
+protected:
+    using HashFn = Hash;  // hash function type
+    static constexpr uint64_t SCHEME_MAGIC = 0x0048534148545845;  // "EXTHASH"
+    // redo records of the write-ahead log, for the changes to the directory between saves
+    static constexpr uint64_t REDO_SPLIT = 1;  // directory prefix of the bucket, page of the new sibling
+    static constexpr uint64_t REDO_MERGE = 2;  // directory index of the merged bucket, its local depth
+    // the directory is indexed by 32 bit integers, and a directory of 2^31 entries already takes 32 GiB
+    static constexpr uint32_t MAX_GLOBAL_DEPTH = 31;
+
+    BufferPool* bp;
+    [[no_unique_address]] HashFn hash_fn;
+    PageChain meta;  // persisted copy of the directory
 
     uint32_t global_depth;
     uint32_t num_buckets;  // keep track of unique buckets till now
     std::vector<std::shared_ptr<Bucket<K, V>>> buckets;
+    std::array<uint32_t, 64> depth_count{};  // number of unique buckets with each local depth
 
     /**
      * Use global depth to find the appropriate bucket for the key
      */
     uint32_t get_bucket_idx(const K &key) const {
         // use the least significant bits of the hashed output as the index
-        return hash_fn(key) & ((1 << global_depth) - 1);
+        return static_cast<uint32_t>(hash_fn(key) & ((uint64_t{1} << global_depth) - 1));
     }
 
     uint32_t get_sibling_idx(const uint32_t bucket_idx, const uint32_t local_depth) {
         // flip the 'local_depth' bit
-        return bucket_idx ^ (1 << (local_depth - 1));
+        return bucket_idx ^ (uint32_t{1} << (local_depth - 1));
+    }
+
+    /**
+     * @brief Check if splitting on the directory bits from `local_depth` on can tell the two hashes apart
+     * Entries whose hashes agree on all of these bits end up in the same bucket however often it is split.
+     */
+    static bool can_separate(uint64_t a, uint64_t b, uint32_t local_depth) {
+        const uint64_t unused_bits = ((uint64_t{1} << MAX_GLOBAL_DEPTH) - 1) & ~((uint64_t{1} << local_depth) - 1);
+        return (a ^ b) & unused_bits;
+    }
+
+    /**
+     * @brief Point all directory entries that share the low `local_depth` bits with bucket_idx to the bucket
+     * These are the 2^(global_depth - local_depth) entries at a stride of 2^local_depth, the rest are untouched.
+     */
+    void point_to(uint32_t bucket_idx, uint32_t local_depth, const std::shared_ptr<Bucket<K, V>> &bucket) {
+        const uint64_t stride = uint64_t{1} << local_depth;
+        for (uint64_t i = bucket_idx & (stride - 1); i < buckets.size(); i += stride) {
+            buckets[i] = bucket;
+        }
     }
 
     /**
      * Grow directory by doubling its size
      */
     void grow() {
-        buckets.reserve(1 << ++global_depth);
+        const OpTimer timer(this->instrumentation, Op::Grow);
+        buckets.reserve(size_t{1} << ++global_depth);
         std::copy(buckets.begin(), buckets.end(), std::back_inserter(buckets));
     }
 
@@ -49,13 +91,12 @@ class ExtendibleHashing : public HashingScheme<K, V> {
     bool shrink() {
         if (!global_depth)
             return false;
-        for (auto &bucket:buckets) {
-            if (bucket->local_depth == global_depth)
-                // can't shrink
-                return false;
-        }
+        if (depth_count[global_depth])
+            // some bucket needs all the bits, can't shrink
+            return false;
+        const OpTimer timer(this->instrumentation, Op::Shrink);
         // simply truncate the second half of the vector
-        buckets.resize(1 << --global_depth);
+        buckets.resize(size_t{1} << --global_depth);
         return true;
     }
 
@@ -66,7 +107,7 @@ class ExtendibleHashing : public HashingScheme<K, V> {
      * the maximum, merge them.
      */
     bool can_combine(std::shared_ptr<Bucket<K, V>> bucket, uint32_t bucket_idx) {
-        if (!bucket->is_empty())
+        if (!bucket->local_depth || !bucket->is_empty())
             return false;
         const uint32_t sibling_idx = get_sibling_idx(bucket_idx, bucket->local_depth);
         auto sibling = buckets[sibling_idx];
@@ -77,46 +118,173 @@ class ExtendibleHashing : public HashingScheme<K, V> {
         return true;
     }
 
-public:
     /**
-     * Initialize the structure with a single bucket
+     * @brief Rebuild the directory from its persisted copy
+     * Only the directory pages are read, the buckets read their own pages lazily when first accessed.
      */
-    explicit ExtendibleHashing(DiskManager* dm, HashFn hash_fn = std::hash<K>{}) : dm(dm), hash_fn(hash_fn),
-                                                                                   global_depth(0), num_buckets(1) {
-        buckets.push_back(std::make_shared<Bucket<K, V>>(dm));
+    void load() {
+        const auto words = meta.read();
+        if (words.size() < 3 || words[0] != SCHEME_MAGIC) {
+            throw std::runtime_error("File does not hold an extendible hashing scheme");
+        }
+        global_depth = words[1];
+        num_buckets = words[2];
+        // the unique buckets, as (page ID, local depth) pairs
+        std::unordered_map<IdT, std::shared_ptr<Bucket<K, V>>> by_page;
+        by_page.reserve(num_buckets);
+        size_t pos = 3;
+        for (uint32_t i = 0; i < num_buckets; ++i, pos += 2) {
+            by_page[words[pos]] = std::make_shared<Bucket<K, V>>(bp, words[pos], words[pos + 1]);
+            ++depth_count[words[pos + 1]];
+        }
+        // followed by the page ID of each directory entry
+        buckets.reserve(size_t{1} << global_depth);
+        for (; pos < words.size(); ++pos) {
+            buckets.push_back(by_page.at(words[pos]));
+        }
+        if (buckets.size() != size_t{1} << global_depth) {
+            throw std::runtime_error("Corrupt directory");
+        }
+        for (const auto &record: bp->get_disk_manager()->get_redo_records()) {
+            redo(record);
+        }
     }
 
-    bool insert(const K &key, const V &value) override {
-        const uint32_t bucket_idx = get_bucket_idx(key);
-        auto bucket = buckets[bucket_idx];
-        while (bucket->is_full()) {
+    /**
+     * @brief Apply a split or merge logged since the directory was saved, without touching the bucket pages
+     * The pages are already as of the end of the committed batch, only the directory is brought up to date.
+     */
+    void redo(const std::vector<uint64_t> &record) {
+        if (record.size() != 3) {
+            throw std::runtime_error("Corrupt redo record");
+        }
+        if (record[0] == REDO_SPLIT) {
+            auto bucket = buckets.at(record[1]);
             if (bucket->local_depth == global_depth) {
                 grow();
             }
-            // new sibling for bucket to be split
-            auto sibling = std::make_shared<Bucket<K, V>>(dm);
-            ++num_buckets;
-            // the mask for the most significant bit that differs between the two buckets
-            const uint32_t mask = 1 << bucket->local_depth;
-            // update the local depths
+            const uint32_t mask = uint32_t{1} << bucket->local_depth;
+            --depth_count[bucket->local_depth];
             ++bucket->local_depth;
-            sibling->local_depth = bucket->local_depth;
+            depth_count[bucket->local_depth] += 2;
+            point_to(record[1] | mask, bucket->local_depth,
+                     std::make_shared<Bucket<K, V>>(bp, record[2], bucket->local_depth));
+            ++num_buckets;
+        } else if (record[0] == REDO_MERGE) {
+            const auto bucket_idx = static_cast<uint32_t>(record[1]);
+            const auto local_depth = static_cast<uint32_t>(record[2]);
+            auto sibling = buckets.at(get_sibling_idx(bucket_idx, local_depth));
+            point_to(bucket_idx, local_depth, sibling);
+            --sibling->local_depth;
+            depth_count[local_depth] -= 2;
+            ++depth_count[sibling->local_depth];
+            --num_buckets;
+            shrink();
+        } else {
+            throw std::runtime_error("Corrupt redo record");
+        }
+    }
+
+    /**
+     * @brief Move the entries of the bucket which have the next bit of their hash set to a new sibling
+     * The directory is doubled if the bucket already uses all of its bits, but not pointed to the sibling yet, which
+     * link_sibling() does.
+     * @param key Key which didn't fit in the bucket
+     * @return The sibling, with the same local depth as the bucket now
+     */
+    std::shared_ptr<Bucket<K, V>> split(Bucket<K, V> &bucket, const K &key) {
+        auto entries = bucket.read_page();
+        const uint64_t hash = hash_fn(key);
+        if (std::ranges::none_of(entries, [&](const auto &entry) {
+            return can_separate(hash_fn(entry.first), hash, bucket.local_depth);
+        })) {
+            // splitting would only keep doubling the directory
+            throw std::runtime_error("Too many entries with the same hash");
+        }
+        if (bucket.local_depth == global_depth) {
+            grow();
+        }
+        // the mask for the most significant bit that differs between the two buckets
+        const uint32_t mask = uint32_t{1} << bucket.local_depth;
+        ++bucket.local_depth;
+
+        // rehash the entries inside the original bucket, ideally half of them would have the mask bit set
+        std::unordered_map<K, V> moved;
+        for (auto it = entries.begin(); it != entries.end();) {
+            auto next = std::next(it);
+            if (get_bucket_idx(it->first) & mask) {
+                moved.insert(entries.extract(it));
+            }
+            it = next;
+        }
+        // write each of the two pages exactly once
+        bucket.write_page(std::move(entries));
+        return std::make_shared<Bucket<K, V>>(bp, std::move(moved), bucket.local_depth);
+    }
+
+    /**
+     * @brief Point the directory entries of a bucket split by split() which have the new bit set to its sibling
+     * @param key Key which didn't fit in the bucket
+     */
+    void link_sibling(const K &key, const std::shared_ptr<Bucket<K, V>> &sibling) {
+        const uint32_t mask = uint32_t{1} << (sibling->local_depth - 1);
+        // the bucket and its sibling replace the bucket of the lower local depth
+        --depth_count[sibling->local_depth - 1];
+        depth_count[sibling->local_depth] += 2;
+        ++num_buckets;
+        point_to(get_bucket_idx(key) | mask, sibling->local_depth, sibling);
+        bp->get_disk_manager()->log_redo(
+                std::array<uint64_t, 3>{REDO_SPLIT, get_bucket_idx(key) & (mask - 1), sibling->page_id});
+    }
 
-            // rehash the entries inside the original bucket
+    /**
+     * @brief Merge the bucket at the directory index with its sibling for as long as it can be combined
+     * Each merge may allow the directory to shrink, after which the merged bucket is checked again.
+     */
+    void merge(uint32_t bucket_idx) {
+        auto bucket = buckets[bucket_idx];
+        while (global_depth > 0 && can_combine(bucket, bucket_idx)) {
+            const OpTimer timer(this->instrumentation, Op::Merge);
+            const uint32_t local_depth = bucket->local_depth;
+            auto sibling = buckets[get_sibling_idx(bucket_idx, local_depth)];
+            // move all remaining values from bucket into its sibling
+            // TODO: The merging policy should tell us whether to move from bucket to sibling or vice versa
+            // the merging policy should try to minimize these moves as much as possible
             for (auto &[key, value]:bucket->read_page()) {
-                // ideally, half the entries would have the mask bit set
-                if (get_bucket_idx(key) & mask) {
-                    // move the entry to the new bucket
-                    bucket->remove(key);
-                    sibling->insert(key, value);
-                }
+                sibling->insert(key, value);
+            }
+            // replace all occurrences of bucket in the directory with its sibling, effectively deleting it
+            point_to(bucket_idx, local_depth, sibling);
+            --sibling->local_depth;
+            depth_count[local_depth] -= 2;
+            ++depth_count[sibling->local_depth];
+            bp->delete_page(bucket->page_id);
+            --num_buckets;
+            bp->get_disk_manager()->log_redo(std::array<uint64_t, 3>{REDO_MERGE, bucket_idx, local_depth});
+
+            // try to halve the directory
+            if (!shrink()) {
+                // couldn't shrink
+                break;
             }
+            bucket = sibling;  // redo the process with the newly merged bucket
+            bucket_idx &= (uint32_t{1} << global_depth) - 1;
+        }
+    }
 
-            // update the directory to point to the new bucket
-            for (int i = 0; i < buckets.size(); ++i) {
-                if (buckets[i] == bucket && i & mask)
-                    buckets[i] = sibling;
+    /**
+     * @brief Insert an entry, splitting its bucket as needed, as a part of an operation which isn't over yet
+     */
+    bool insert_entry(const K &key, const V &value) {
+        const uint32_t bucket_idx = get_bucket_idx(key);
+        auto bucket = buckets[bucket_idx];
+        while (bucket->is_full(key, value)) {
+            if (bucket->is_empty()) {
+                // splitting would never make room for it
+                throw std::runtime_error("Entry does not fit in a page");
             }
+            const OpTimer timer(this->instrumentation, Op::Split);
+            link_sibling(key, split(*bucket, key));
             bucket = buckets[get_bucket_idx(key)];
             // Edge case: All entries got rehashed into one bucket, need to split again, so loop back
         }
@@ -124,6 +292,221 @@ public:
         return bucket->insert(key, value);
     }
 
+    struct StagedEntry {
+        uint64_t hash;
+        K key;
+        V value;
+    };
+
+    /**
+     * @brief A run of staged entries which goes into one bucket, along with the directory bits the bucket covers
+     */
+    struct BulkPart {
+        std::span<StagedEntry> entries;
+        uint32_t prefix;
+        uint32_t local_depth;
+    };
+
+    /**
+     * @brief Split the entries on their next hash bit till each part fits in a bucket
+     * @param prefix Low `local_depth` bits shared by the hashes of all the entries
+     * @param capacity Number of entries which fit in a bucket
+     */
+    static void plan_parts(std::span<StagedEntry> entries, uint32_t prefix, uint32_t local_depth, uint32_t capacity,
+                           std::vector<BulkPart> &parts) {
+        // entries that still don't fit are inserted one by one later
+        if (entries.size() <= capacity) {
+            parts.push_back({entries, prefix, local_depth});
+            return;
+        }
+        // stop once no further bit separates the entries, every split would leave one side empty and only double the
+        // directory
+        const uint64_t first_hash = entries.front().hash;
+        if (std::ranges::none_of(entries, [&](const StagedEntry &e) {
+            return can_separate(e.hash, first_hash, local_depth);
+        })) {
+            parts.push_back({entries, prefix, local_depth});
+            return;
+        }
+        const uint64_t bit = uint64_t{1} << local_depth;
+        auto mid = std::partition(entries.begin(), entries.end(), [&](const StagedEntry &e) {
+            return !(e.hash & bit);
+        });
+        const auto split = static_cast<size_t>(mid - entries.begin());
+        plan_parts(entries.first(split), prefix, local_depth + 1, capacity, parts);
+        plan_parts(entries.subspan(split), prefix | bit, local_depth + 1, capacity, parts);
+    }
+
+    /**
+     * @brief Fill an empty directory with the given entries, writing every bucket page once
+     */
+    void bulk_load(std::vector<StagedEntry> &&staged) {
+        // drop repeated keys, keeping the first value like insert does; equal keys have equal hashes
+        std::stable_sort(staged.begin(), staged.end(), [](const StagedEntry &a, const StagedEntry &b) {
+            return a.hash < b.hash;
+        });
+        size_t num_unique = 0;
+        for (size_t i = 0; i < staged.size(); ++i) {
+            bool repeated = false;
+            for (size_t j = num_unique; j-- > 0 && staged[j].hash == staged[i].hash;) {
+                repeated |= staged[j].key == staged[i].key;
+            }
+            if (!repeated) {
+                if (i != num_unique) {
+                    staged[num_unique] = std::move(staged[i]);
+                }
+                ++num_unique;
+            }
+        }
+        staged.erase(staged.begin() + static_cast<std::ptrdiff_t>(num_unique), staged.end());
+
+        // the final shape of the directory is known before anything is written
+        std::vector<BulkPart> parts;
+        plan_parts(staged, 0, 0, Bucket<K, V>::capacity_for(bp->get_page_size()), parts);
+        for (const auto &part: parts) {
+            global_depth = std::max(global_depth, part.local_depth);
+        }
+        buckets.assign(size_t{1} << global_depth, nullptr);
+        num_buckets = parts.size();
+
+        std::unordered_map<K, V> leftover;
+        for (const auto &part: parts) {
+            std::unordered_map<K, V> entries;
+            entries.reserve(part.entries.size());
+            for (auto &entry: part.entries) {
+                entries.emplace(std::move(entry.key), std::move(entry.value));
+            }
+            auto bucket = std::make_shared<Bucket<K, V>>(bp, bp->new_page(), part.local_depth);
+            bucket->fill(entries);
+            // only entries of the serialized layout, whose size is estimated, or of a weak hash can be left
+            leftover.merge(entries);
+            point_to(part.prefix, part.local_depth, bucket);
+            ++depth_count[part.local_depth];
+        }
+        for (auto &[key, value]: leftover) {
+            insert_entry(key, value);
+        }
+    }
+
+    /**
+     * @brief Call fn(bucket, positions) once for each bucket holding some of the keys, with the positions of its keys
+     * The positions of each bucket are in increasing order. Splits done by fn only affect the bucket passed to it,
+     * so the buckets of the other keys stay valid.
+     */
+    template<typename Fn>
+    void for_each_bucket(std::span<const K> keys, Fn fn) {
+        std::vector<std::shared_ptr<Bucket<K, V>>> dest(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            dest[i] = buckets[get_bucket_idx(keys[i])];
+        }
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return dest[a]->page_id < dest[b]->page_id;
+        });
+        // start reading all the buckets at once, they are read one at a time otherwise
+        std::vector<IdT> page_ids;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (!i || dest[order[i]] != dest[order[i - 1]]) {
+                page_ids.push_back(dest[order[i]]->page_id);
+            }
+        }
+        bp->prefetch(page_ids);
+        for (size_t start = 0, end; start < order.size(); start = end) {
+            for (end = start + 1; end < order.size() && dest[order[end]] == dest[order[start]]; ++end);
+            fn(dest[order[start]], std::span<const size_t>(order).subspan(start, end - start));
+        }
+    }
+
+public:
+    /**
+     * Initialize the structure with a single bucket, or reopen the one stored in the file
+     */
+    explicit ExtendibleHashing(BufferPool* bp, HashFn hash_fn = HashFn{})
+            : bp(bp), hash_fn(std::move(hash_fn)), meta(bp, bp->get_disk_manager()->get_root_page()), global_depth(0),
+              num_buckets(1) {
+        if (meta.get_head()) {
+            load();
+            return;
+        }
+        meta = PageChain(bp);
+        bp->get_disk_manager()->set_root_page(meta.get_head());
+        buckets.push_back(std::make_shared<Bucket<K, V>>(bp));
+        depth_count[0] = 1;
+        if (bp->get_disk_manager()->has_write_ahead_log()) {
+            // redo records are replayed on top of a saved directory, so start with one
+            save();
+        }
+    }
+
+    /**
+     * @brief Build the structure from a range of key/value pairs, instead of inserting them one by one
+     * The entries are partitioned by the low bits of their hashes till each part fits in a bucket, so the final
+     * global depth is picked up front, and no bucket is split nor the directory doubled while loading.
+     * Repeated keys keep their first value.
+     * @param entries The file must not hold a structure yet
+     */
+    template<std::ranges::input_range R>
+    explicit ExtendibleHashing(BufferPool* bp, R &&entries, HashFn hash_fn = HashFn{})
+            : bp(bp), hash_fn(std::move(hash_fn)), meta(bp, bp->get_disk_manager()->get_root_page()), global_depth(0),
+              num_buckets(0) {
+        if (meta.get_head()) {
+            throw std::runtime_error("File already holds a structure, can't bulk load into it");
+        }
+        meta = PageChain(bp);
+        bp->get_disk_manager()->set_root_page(meta.get_head());
+        std::vector<StagedEntry> staged;
+        if constexpr (std::ranges::sized_range<R>) {
+            staged.reserve(std::ranges::size(entries));
+        }
+        for (auto &&[key, value]: entries) {
+            staged.push_back({this->hash_fn(key), key, value});
+        }
+        bulk_load(std::move(staged));
+        if (bp->get_disk_manager()->has_write_ahead_log()) {
+            save();
+        }
+    }
+
+    ~ExtendibleHashing() override {
+        save();
+    }
+
+    /**
+     * @brief Persist the directory, so that the structure can be reopened from the file
+     */
+    void save() {
+        std::vector<uint64_t> words{SCHEME_MAGIC, global_depth, num_buckets};
+        words.reserve(3 + 2 * num_buckets + buckets.size());
+        std::unordered_set<Bucket<K, V>*> done;
+        for (auto &bucket: buckets) {
+            if (done.insert(bucket.get()).second) {
+                words.push_back(bucket->page_id);
+                words.push_back(bucket->local_depth);
+            }
+        }
+        words[2] = done.size();
+        for (auto &bucket: buckets) {
+            words.push_back(bucket->page_id);
+        }
+        meta.write(words);
+        bp->get_disk_manager()->clear_redo();
+    }
+
+    uint32_t get_global_depth() const {
+        return global_depth;
+    }
+
+    uint32_t get_num_buckets() const {
+        return num_buckets;
+    }
+
+    bool insert(const K &key, const V &value) override {
+        const bool inserted = insert_entry(key, value);
+        bp->end_operation();
+        return inserted;
+    }
+
     /**
      * @brief Get the value for the given key
      * @param[out] value Pointer to output value
@@ -145,30 +528,51 @@ public:
             // not found
             return false;
 
-        while (global_depth > 0 && can_combine(bucket, bucket_idx)) {
-            auto sibling = buckets[get_sibling_idx(bucket_idx, bucket->local_depth)];
-            // move all remaining values from bucket into its sibling
-            // TODO: The merging policy should tell us whether to move from bucket to sibling or vice versa
-            // the merging policy should try to minimize these moves as much as possible
-            for (auto &[key, value]:bucket->read_page()) {
-                sibling->insert(key, value);
-            }
-            // replace all occurrences of bucket in the directory with its sibling, effectively deleting it
-            for (auto &buck:buckets) {
-                if (buck == bucket) {
-                    buck = sibling;
-                }
+        merge(bucket_idx);
+        bp->end_operation();
+        return true;
+    }
+
+    size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) override {
+        this->check_batch(keys.size(), values.size());
+        found.assign(keys.size(), false);
+        size_t num_found = 0;
+        for_each_bucket(keys, [&](const std::shared_ptr<Bucket<K, V>> &bucket, std::span<const size_t> idxs) {
+            num_found += bucket->find_batch(keys, idxs, values, found);
+        });
+        return num_found;
+    }
+
+    size_t multi_insert(std::span<const K> keys, std::span<const V> values) override {
+        this->check_batch(keys.size(), values.size());
+        size_t num_inserted = 0;
+        for_each_bucket(keys, [&](const std::shared_ptr<Bucket<K, V>> &bucket, std::span<const size_t> idxs) {
+            const size_t processed = bucket->insert_batch(keys, values, idxs, num_inserted);
+            // the bucket is full, insert the rest one by one, splitting it as needed
+            for (const auto i: idxs.subspan(processed)) {
+                num_inserted += insert_entry(keys[i], values[i]);
             }
-            --sibling->local_depth;
+        });
+        bp->end_operation();
+        return num_inserted;
+    }
 
-            // try to halve the directory
-            if (!shrink()) {
-                // couldn't shrink
-                break;
+    size_t multi_remove(std::span<const K> keys) override {
+        std::vector<bool> removed(keys.size());
+        std::vector<K> emptied;  // a key of each bucket which might be merged
+        size_t num_removed = 0;
+        for_each_bucket(keys, [&](const std::shared_ptr<Bucket<K, V>> &bucket, std::span<const size_t> idxs) {
+            num_removed += bucket->remove_batch(keys, idxs, removed);
+            if (bucket->local_depth && bucket->is_empty()) {
+                emptied.push_back(keys[idxs.front()]);
             }
-            bucket = sibling;  // redo the process with the newly merged bucket
+        });
+        // merge after all the removals, as merging changes the buckets of other keys
+        for (const auto &key: emptied) {
+            merge(get_bucket_idx(key));
         }
-        return true;
+        bp->end_operation();
+        return num_removed;
     }
 
     /**
@@ -184,8 +588,8 @@ public:
         // generate the main directory
         out << "\tsubgraph directory {\n"
             << "\t\tarray [label=\"";
-        const uint32_t max = (1 << global_depth) - 1;
-        for (int i = 0; i <= max; ++i) {
+        const size_t max = (size_t{1} << global_depth) - 1;
+        for (size_t i = 0; i <= max; ++i) {
             // "a0" is a label for the first element of the directory, used later to draw edges
             // `{0:0{1}b}` ensures that we print exactly `global_depth` number of bits, padded by 0s to the left
             fmt::print(out, "<a{0}> {0:0{1}b}{2}", i, global_depth, (i == max ? "" : " | "));
@@ -0,0 +1,298 @@
+#ifndef HASHES_HPP
+#define HASHES_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+/**
+ * @brief Fast non-cryptographic hash functions over byte strings
+ * The functors below apply them to keys, and can be passed as the hash function of any scheme.
+ */
+struct Hashes {
+    /**
+     * @brief Murmur3 64 bit finalizer, spreads the entropy of the input over all of its bits
+     */
+    static uint64_t fmix64(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccd;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /**
+     * @brief Fold the bytes into the finalizer 8 at a time, a single round for keys of up to 8 bytes
+     */
+    static uint64_t murmur(const char* data, size_t len, uint64_t seed) {
+        uint64_t h = seed;
+        for (size_t i = 0; i < len; i += 8) {
+            uint64_t chunk = 0;
+            memcpy(&chunk, data + i, std::min<size_t>(8, len - i));
+            h = fmix64(h ^ chunk);
+        }
+        return len > 8 ? fmix64(h ^ len) : h;
+    }
+
+    /**
+     * @brief wyhash (final version 4)
+     */
+    static uint64_t wyhash(const char* data, size_t len, uint64_t seed) {
+        constexpr uint64_t secret[4] = {0xa0761d6478bd642f, 0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3,
+                                        0x589965cc75374cc3};
+        const auto* p = reinterpret_cast<const uint8_t*>(data);
+        seed ^= wymix(seed ^ secret[0], secret[1]);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+                b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = (uint64_t{p[0]} << 16) | (uint64_t{p[len >> 1]} << 8) | p[len - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = wymix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+                    see1 = wymix(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+                    see2 = wymix(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = wymix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        a ^= secret[1];
+        b ^= seed;
+        wymum(a, b);
+        return wymix(a ^ secret[0] ^ len, b ^ secret[1]);
+    }
+
+    /**
+     * @brief XXH64
+     */
+    static uint64_t xxh64(const char* data, size_t len, uint64_t seed) {
+        const auto* p = reinterpret_cast<const uint8_t*>(data);
+        const auto* const end = p + len;
+        uint64_t h;
+        if (len >= 32) {
+            uint64_t v1 = seed + XXH_P1 + XXH_P2, v2 = seed + XXH_P2, v3 = seed, v4 = seed - XXH_P1;
+            do {
+                v1 = xxh_round(v1, read64(p));
+                v2 = xxh_round(v2, read64(p + 8));
+                v3 = xxh_round(v3, read64(p + 16));
+                v4 = xxh_round(v4, read64(p + 24));
+                p += 32;
+            } while (end - p >= 32);
+            h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+            for (const uint64_t v: {v1, v2, v3, v4}) {
+                h = (h ^ xxh_round(0, v)) * XXH_P1 + XXH_P4;
+            }
+        } else {
+            h = seed + XXH_P5;
+        }
+        h += len;
+        for (; end - p >= 8; p += 8) {
+            h = std::rotl(h ^ xxh_round(0, read64(p)), 27) * XXH_P1 + XXH_P4;
+        }
+        if (end - p >= 4) {
+            h = std::rotl(h ^ (read32(p) * XXH_P1), 23) * XXH_P2 + XXH_P3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h = std::rotl(h ^ (*p * XXH_P5), 11) * XXH_P1;
+        }
+        h ^= h >> 33;
+        h *= XXH_P2;
+        h ^= h >> 29;
+        h *= XXH_P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    /**
+     * @brief CRC32C (Castagnoli), with the SSE4.2 crc32 instruction if the CPU has it
+     */
+    static uint32_t crc32c(const char* data, size_t len, uint32_t crc = 0) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+        if (has_sse42) {
+            return crc32c_sse42(data, len, crc);
+        }
+#endif
+        crc = ~crc;
+        for (size_t i = 0; i < len; ++i) {
+            crc ^= static_cast<uint8_t>(data[i]);
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    /**
+     * @brief Get the bytes which identify a key: the characters of strings, or the object representation of
+     * trivially copyable types, which must not have padding bytes or several representations of equal values
+     */
+    template<typename K>
+    static std::string_view key_bytes(const K &key) {
+        if constexpr (std::is_convertible_v<const K &, std::string_view>) {
+            return std::string_view(key);
+        } else {
+            static_assert(std::has_unique_object_representations_v<K>,
+                          "Keys must be strings or have a unique object representation");
+            return {reinterpret_cast<const char*>(&key), sizeof(K)};
+        }
+    }
+
+private:
+    static constexpr uint64_t XXH_P1 = 0x9E3779B185EBCA87;
+    static constexpr uint64_t XXH_P2 = 0xC2B2AE3D27D4EB4F;
+    static constexpr uint64_t XXH_P3 = 0x165667B19E3779F9;
+    static constexpr uint64_t XXH_P4 = 0x85EBCA77C2B2AE63;
+    static constexpr uint64_t XXH_P5 = 0x27D4EB2F165667C5;
+
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    /**
+     * @brief 128 bit product of a and b, low half in a and high half in b
+     */
+    static void wymum(uint64_t &a, uint64_t &b) {
+        const __uint128_t r = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+    }
+
+    static uint64_t wymix(uint64_t a, uint64_t b) {
+        wymum(a, b);
+        return a ^ b;
+    }
+
+    static uint64_t xxh_round(uint64_t acc, uint64_t input) {
+        return std::rotl(acc + input * XXH_P2, 31) * XXH_P1;
+    }
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32c_sse42(const char* data, size_t len, uint32_t crc) {
+        uint64_t c = ~crc;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t chunk;
+            memcpy(&chunk, data + i, sizeof(chunk));
+            c = _mm_crc32_u64(c, chunk);
+        }
+        for (; i < len; ++i) {
+            c = _mm_crc32_u8(static_cast<uint32_t>(c), static_cast<uint8_t>(data[i]));
+        }
+        return ~static_cast<uint32_t>(c);
+    }
+#endif
+};
+
+/**
+ * @brief Murmur3 finalizer based hash, the cheapest of these for integer keys
+ * A non-zero seed makes the hash unpredictable to clients choosing colliding keys on purpose, as for the others.
+ */
+struct MurmurHash {
+    uint64_t seed{0};
+
+    template<typename K>
+    uint64_t operator()(const K &key) const {
+        const auto bytes = Hashes::key_bytes(key);
+        return Hashes::murmur(bytes.data(), bytes.size(), seed);
+    }
+};
+
+struct WyHash {
+    uint64_t seed{0};
+
+    template<typename K>
+    uint64_t operator()(const K &key) const {
+        const auto bytes = Hashes::key_bytes(key);
+        return Hashes::wyhash(bytes.data(), bytes.size(), seed);
+    }
+};
+
+struct XXHash64 {
+    uint64_t seed{0};
+
+    template<typename K>
+    uint64_t operator()(const K &key) const {
+        const auto bytes = Hashes::key_bytes(key);
+        return Hashes::xxh64(bytes.data(), bytes.size(), seed);
+    }
+};
+
+/**
+ * @brief CRC32C based hash, only the low 32 bits are set
+ */
+struct Crc32cHash {
+    uint32_t seed{0};
+
+    template<typename K>
+    uint64_t operator()(const K &key) const {
+        const auto bytes = Hashes::key_bytes(key);
+        return Hashes::crc32c(bytes.data(), bytes.size(), seed);
+    }
+};
+
+/**
+ * @brief Hash used by the schemes unless another one is given: MurmurHash, or std::hash for keys it can't take
+ */
+template<typename K>
+using DefaultHash = std::conditional_t<std::is_convertible_v<const K &, std::string_view> ||
+                                       std::has_unique_object_representations_v<K>, MurmurHash, std::hash<K>>;
+
+/**
+ * @brief Type-erased hash function, for picking the hash of a scheme at runtime
+ * Any callable taking a key and returning an integer converts to it, at the cost of an indirect call per hash.
+ */
+template<typename K>
+class HashFunction {
+    std::function<uint64_t(const K &)> fn;
+
+public:
+    HashFunction() : fn(std::hash<K>{}) {}
+
+    template<typename Fn>
+    requires (!std::is_same_v<std::remove_cvref_t<Fn>, HashFunction> && std::is_invocable_r_v<uint64_t, Fn &, const K &>)
+    HashFunction(Fn hash) : fn(std::move(hash)) {}
+
+    uint64_t operator()(const K &key) const {
+        return fn(key);
+    }
+};
+
+#endif //HASHES_HPP
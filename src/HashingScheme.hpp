@@ -1,6 +1,12 @@
 #ifndef HASHINGSCHEME_HPP
 #define HASHINGSCHEME_HPP
 
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "Instrumentation.hpp"
+
 template<typename K, typename V>
 class HashingScheme {
 public:
@@ -10,7 +16,68 @@ public:
 
     virtual bool remove(const K &key) = 0;
 
+    /**
+     * @brief Look up a batch of keys
+     * Schemes which store entries in pages override this to read each page once per batch.
+     * @param[out] values The value of keys[i] is written to values[i], if found
+     * @param[out] found Set to true at position i if keys[i] was found
+     * @return Number of keys found
+     */
+    virtual size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) {
+        check_batch(keys.size(), values.size());
+        found.assign(keys.size(), false);
+        size_t num_found = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            found[i] = get(keys[i], &values[i]);
+            num_found += found[i];
+        }
+        return num_found;
+    }
+
+    /**
+     * @brief Insert a batch of entries, (keys[i], values[i])
+     * @return Number of entries inserted, keys which are already present are skipped
+     */
+    virtual size_t multi_insert(std::span<const K> keys, std::span<const V> values) {
+        check_batch(keys.size(), values.size());
+        size_t num_inserted = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            num_inserted += insert(keys[i], values[i]);
+        }
+        return num_inserted;
+    }
+
+    /**
+     * @brief Remove a batch of keys
+     * @return Number of keys removed
+     */
+    virtual size_t multi_remove(std::span<const K> keys) {
+        size_t num_removed = 0;
+        for (const auto &key: keys) {
+            num_removed += remove(key);
+        }
+        return num_removed;
+    }
+
+    /**
+     * @brief Record the latencies of the splits, merges and resizes done by the scheme, see InstrumentedScheme to also
+     * record the ones of each operation
+     * @param instr nullptr stops the recording, which then costs a single check per structural change
+     */
+    virtual void set_instrumentation(Instrumentation* instr) {
+        instrumentation = instr;
+    }
+
     virtual ~HashingScheme() {};
+
+protected:
+    Instrumentation* instrumentation{nullptr};
+
+    static void check_batch(size_t num_keys, size_t num_values) {
+        if (num_keys != num_values) {
+            throw std::runtime_error("Batch sizes don't match");
+        }
+    }
 };
 
 
@@ -0,0 +1,196 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+
+/**
+ * @brief Histogram of latencies in nanoseconds, with log-scaled buckets as in HdrHistogram
+ * Each power of two is split into SUB_BUCKETS linear buckets, so recorded values are kept with a relative error of at
+ * most 1 / SUB_BUCKETS. Recording is lock free, and the histogram can be read while other threads record into it.
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr uint32_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts{};
+    std::atomic<uint64_t> total{};
+    std::atomic<uint64_t> sum{};
+    std::atomic<uint64_t> max_value{};
+
+    static uint32_t bucket_of(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        const uint32_t exponent = std::bit_width(value) - 1;
+        const uint32_t shift = exponent - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t lowest_in(uint32_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        const uint32_t shift = bucket / SUB_BUCKETS - 1;
+        return (uint64_t{SUB_BUCKETS} + bucket % SUB_BUCKETS) << shift;
+    }
+
+    static uint64_t highest_in(uint32_t bucket) {
+        return bucket + 1 == NUM_BUCKETS ? UINT64_MAX : lowest_in(bucket + 1) - 1;
+    }
+
+public:
+    void record(uint64_t nanos) {
+        counts[bucket_of(nanos)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanos, std::memory_order_relaxed);
+        uint64_t seen = max_value.load(std::memory_order_relaxed);
+        while (nanos > seen && !max_value.compare_exchange_weak(seen, nanos, std::memory_order_relaxed));
+    }
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return max_value.load(std::memory_order_relaxed);
+    }
+
+    double mean() const {
+        const uint64_t n = count();
+        return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0;
+    }
+
+    /**
+     * @brief Get the latency which the given percentage of the recorded ones don't exceed
+     * @param percent Between 0 and 100
+     * @return Upper end of the bucket holding that latency, or 0 if nothing was recorded
+     */
+    uint64_t percentile(double percent) const {
+        const uint64_t n = count();
+        if (!n) {
+            return 0;
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percent / 100 * n)));
+        uint64_t seen = 0;
+        for (uint32_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+            seen += counts[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(highest_in(bucket), max());
+            }
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto &c: counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        total = sum = max_value = 0;
+    }
+};
+
+/**
+ * @brief Operations whose latencies are recorded: the ones of HashingScheme, and the structural changes they cause
+ * Other stands for anything outside of them, such as loading or saving a scheme, and is never timed.
+ */
+enum class Op {
+    Insert, Get, Remove, Split, Merge, Grow, Shrink, Other
+};
+
+/**
+ * @brief One latency histogram per operation, recorded into by the schemes it is given to
+ */
+class Instrumentation {
+public:
+    static constexpr size_t NUM_OPS = 8;
+    static constexpr std::array<const char*, NUM_OPS> OP_NAMES{"insert", "get", "remove", "split", "merge", "grow",
+                                                              "shrink", "other"};
+
+private:
+    std::array<LatencyHistogram, NUM_OPS> histograms;
+
+public:
+    LatencyHistogram &operator[](Op op) {
+        return histograms[static_cast<size_t>(op)];
+    }
+
+    const LatencyHistogram &operator[](Op op) const {
+        return histograms[static_cast<size_t>(op)];
+    }
+
+    /**
+     * @brief Print the count, mean, tail percentiles and maximum of each operation that was recorded, in nanoseconds
+     */
+    void dump(std::ostream &out) const {
+        for (size_t i = 0; i < NUM_OPS; ++i) {
+            const auto &h = histograms[i];
+            if (!h.count()) {
+                continue;
+            }
+            out << OP_NAMES[i] << ": count=" << h.count() << " mean=" << static_cast<uint64_t>(h.mean())
+                << "ns p50=" << h.percentile(50) << "ns p99=" << h.percentile(99) << "ns p99.9="
+                << h.percentile(99.9) << "ns max=" << h.max() << "ns\n";
+        }
+    }
+
+    void reset() {
+        for (auto &h: histograms) {
+            h.reset();
+        }
+    }
+};
+
+/**
+ * @brief Record the time till the end of the scope into the histogram of an operation
+ * The operation is also made the current one of the thread for the same scope, so that the I/O it causes is
+ * attributed to it. Does nothing, and doesn't read the clock, if there is no instrumentation.
+ */
+class OpTimer {
+    using Clock = std::chrono::steady_clock;
+
+    static inline thread_local Op current_op = Op::Other;
+
+    LatencyHistogram* histogram;
+    Clock::time_point start;
+    Op previous{Op::Other};
+
+public:
+    OpTimer(Instrumentation* instrumentation, Op op)
+            : histogram(instrumentation ? &(*instrumentation)[op] : nullptr) {
+        if (histogram) {
+            previous = std::exchange(current_op, op);
+            start = Clock::now();
+        }
+    }
+
+    /**
+     * @brief Innermost operation being timed on the calling thread, Op::Other if there is none
+     */
+    static Op current() {
+        return current_op;
+    }
+
+    OpTimer(const OpTimer &) = delete;
+
+    OpTimer &operator=(const OpTimer &) = delete;
+
+    ~OpTimer() {
+        if (histogram) {
+            histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+            current_op = previous;
+        }
+    }
+};
+
+#endif //INSTRUMENTATION_HPP
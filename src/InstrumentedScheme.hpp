@@ -0,0 +1,64 @@
+#ifndef INSTRUMENTEDSCHEME_HPP
+#define INSTRUMENTEDSCHEME_HPP
+
+#include <span>
+#include <vector>
+#include "HashingScheme.hpp"
+#include "Instrumentation.hpp"
+
+/**
+ * @brief Wrap a scheme to record the latency of each of its operations, along with its splits, merges and resizes
+ * Schemes which aren't wrapped record nothing, so instrumentation costs nothing unless asked for. Batched operations
+ * are passed through to the wrapped scheme as they are, without being recorded.
+ */
+template<typename K, typename V>
+class InstrumentedScheme : public HashingScheme<K, V> {
+    HashingScheme<K, V>* scheme;
+
+public:
+    /**
+     * @param scheme Must outlive the wrapper
+     * @param instr Histograms to record into, can be shared by several wrapped schemes
+     */
+    InstrumentedScheme(HashingScheme<K, V>* scheme, Instrumentation* instr) : scheme(scheme) {
+        set_instrumentation(instr);
+    }
+
+    ~InstrumentedScheme() override {
+        scheme->set_instrumentation(nullptr);
+    }
+
+    void set_instrumentation(Instrumentation* instr) override {
+        this->instrumentation = instr;
+        scheme->set_instrumentation(instr);
+    }
+
+    bool insert(const K &key, const V &value) override {
+        const OpTimer timer(this->instrumentation, Op::Insert);
+        return scheme->insert(key, value);
+    }
+
+    bool get(const K &key, V* value) override {
+        const OpTimer timer(this->instrumentation, Op::Get);
+        return scheme->get(key, value);
+    }
+
+    bool remove(const K &key) override {
+        const OpTimer timer(this->instrumentation, Op::Remove);
+        return scheme->remove(key);
+    }
+
+    size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) override {
+        return scheme->multi_get(keys, values, found);
+    }
+
+    size_t multi_insert(std::span<const K> keys, std::span<const V> values) override {
+        return scheme->multi_insert(keys, values);
+    }
+
+    size_t multi_remove(std::span<const K> keys) override {
+        return scheme->multi_remove(keys);
+    }
+};
+
+#endif //INSTRUMENTEDSCHEME_HPP
@@ -0,0 +1,133 @@
+#ifndef IOSTATS_HPP
+#define IOSTATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
+#include "common.h"
+#include "Instrumentation.hpp"
+
+/**
+ * @brief Page I/O done by a DiskManager, broken down by the operation causing it and by page
+ * Reads and writes are attributed to the innermost operation timed on the calling thread (see OpTimer), so a scheme
+ * must be instrumented for its I/O to be told apart, otherwise it all counts as Op::Other. Counting pages is opt-in,
+ * as it takes a latch on every I/O.
+ */
+class IoStats {
+public:
+    struct Counters {
+        std::atomic<uint64_t> reads{};
+        std::atomic<uint64_t> writes{};
+        std::atomic<uint64_t> bytes_read{};
+        std::atomic<uint64_t> bytes_written{};
+    };
+
+    struct PageHeat {
+        IdT page_id;
+        uint64_t reads;
+        uint64_t writes;
+    };
+
+private:
+    std::array<Counters, Instrumentation::NUM_OPS> per_op;
+    std::atomic<bool> track_pages{false};
+    mutable std::mutex heat_latch;  // guards heat
+    std::unordered_map<IdT, std::pair<uint64_t, uint64_t>> heat;  // reads and writes of each page
+
+public:
+    void record_read(IdT page_id, uint64_t bytes) {
+        auto &counters = per_op[static_cast<size_t>(OpTimer::current())];
+        counters.reads.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+        if (track_pages.load(std::memory_order_relaxed)) {
+            std::lock_guard guard(heat_latch);
+            ++heat[page_id].first;
+        }
+    }
+
+    void record_write(IdT page_id, uint64_t bytes) {
+        auto &counters = per_op[static_cast<size_t>(OpTimer::current())];
+        counters.writes.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+        if (track_pages.load(std::memory_order_relaxed)) {
+            std::lock_guard guard(heat_latch);
+            ++heat[page_id].second;
+        }
+    }
+
+    /**
+     * @brief Start or stop counting the reads and writes of each page, the counts so far are kept
+     */
+    void set_page_tracking(bool enabled) {
+        track_pages = enabled;
+    }
+
+    const Counters &operator[](Op op) const {
+        return per_op[static_cast<size_t>(op)];
+    }
+
+    /**
+     * @brief Get the pages with the most reads and writes, since page tracking was enabled
+     */
+    std::vector<PageHeat> hottest_pages(size_t n) const {
+        std::vector<PageHeat> pages;
+        {
+            std::lock_guard guard(heat_latch);
+            pages.reserve(heat.size());
+            for (const auto &[page_id, counts]: heat) {
+                pages.push_back({page_id, counts.first, counts.second});
+            }
+        }
+        n = std::min(n, pages.size());
+        std::partial_sort(pages.begin(), pages.begin() + n, pages.end(), [](const PageHeat &a, const PageHeat &b) {
+            return a.reads + a.writes != b.reads + b.writes ? a.reads + a.writes > b.reads + b.writes
+                                                            : a.page_id < b.page_id;
+        });
+        pages.resize(n);
+        return pages;
+    }
+
+    void reset() {
+        for (auto &counters: per_op) {
+            counters.reads = counters.writes = counters.bytes_read = counters.bytes_written = 0;
+        }
+        std::lock_guard guard(heat_latch);
+        heat.clear();
+    }
+
+    /**
+     * @brief Snapshot of the counters as a JSON object, with the operations which did any I/O and the hottest pages
+     */
+    std::string to_json(size_t num_hot_pages = 10) const {
+        uint64_t reads = 0, writes = 0, bytes_read = 0, bytes_written = 0;
+        std::string ops;
+        for (size_t i = 0; i < per_op.size(); ++i) {
+            const auto &c = per_op[i];
+            reads += c.reads;
+            writes += c.writes;
+            bytes_read += c.bytes_read;
+            bytes_written += c.bytes_written;
+            if (c.reads || c.writes) {
+                ops += fmt::format(R"({}"{}": {{"reads": {}, "writes": {}, "bytes_read": {}, "bytes_written": {}}})",
+                                   ops.empty() ? "" : ", ", Instrumentation::OP_NAMES[i], c.reads.load(),
+                                   c.writes.load(), c.bytes_read.load(), c.bytes_written.load());
+            }
+        }
+        std::string pages;
+        for (const auto &page: hottest_pages(num_hot_pages)) {
+            pages += fmt::format(R"({}{{"page_id": {}, "reads": {}, "writes": {}}})", pages.empty() ? "" : ", ",
+                                 page.page_id, page.reads, page.writes);
+        }
+        return fmt::format(R"({{"reads": {}, "writes": {}, "bytes_read": {}, "bytes_written": {}, )"
+                           R"("operations": {{{}}}, "hot_pages": [{}]}})",
+                           reads, writes, bytes_read, bytes_written, ops, pages);
+    }
+};
+
+#endif //IOSTATS_HPP
@@ -0,0 +1,218 @@
+#ifndef LINEARHASHING_HPP
+#define LINEARHASHING_HPP
+
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "Bucket.hpp"
+#include "BufferPool.hpp"
+#include "Hashes.hpp"
+#include "HashingScheme.hpp"
+#include "PageChain.hpp"
+
+/**
+ * @brief Linear hashing, which grows by splitting one slot at a time, without a directory
+ * Slots are split in order, pointed to by the split pointer, whenever the load factor crosses the limit.
+ * A round of splits doubles the number of slots and increments the level. Keys in slots before the split pointer
+ * have already been rehashed with one more bit, the rest still use `level` bits.
+ * Slots which receive more entries than a page can hold keep them in a chain of overflow buckets.
+ * @tparam Hash Hash function, called directly so that it can be inlined. Use HashFunction<K> to pick one at runtime.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
+class LinearHashing : public HashingScheme<K, V> {
+    using HashFn = Hash;  // hash function type
+    static constexpr uint64_t SCHEME_MAGIC = 0x00485341484E494C;  // "LINHASH"
+private:
+    uint32_t level{0};  // number of completed rounds of splits, a round starts with 2^level slots
+    uint64_t split_ptr{0};  // next slot to split
+    uint64_t num_entries{0};
+    const double max_load_factor;
+    std::vector<std::list<Bucket<K, V>>> slots;
+    BufferPool* bp;
+    [[no_unique_address]] HashFn hash_fn;
+    PageChain meta;  // persisted copy of the bucket chains
+
+    uint64_t get_slot(const K &key) const {
+        const auto hashed = hash_fn(key);
+        const uint64_t slot = hashed & ((1ULL << level) - 1);
+        if (slot < split_ptr) {
+            // this slot has been split in the current round, so its keys use one more bit
+            return hashed & ((1ULL << (level + 1)) - 1);
+        }
+        return slot;
+    }
+
+    double load_factor() const {
+        const uint32_t capacity = Bucket<K, V>::capacity_for(bp->get_page_size());
+        return static_cast<double>(num_entries) / static_cast<double>(slots.size() * capacity);
+    }
+
+    /**
+     * @brief Store the entries in the chain, reusing its buckets and writing each page once
+     */
+    void write_chain(std::list<Bucket<K, V>> &chain, std::unordered_map<K, V> &&entries) {
+        auto it = chain.begin();
+        while (!entries.empty()) {
+            if (it == chain.end()) {
+                it = chain.emplace(it, bp, bp->new_page());
+            }
+            it->fill(entries);
+            ++it;
+        }
+        // the entries fit in fewer buckets than before, free the rest
+        while (it != chain.end()) {
+            bp->delete_page(it->page_id);
+            it = chain.erase(it);
+        }
+    }
+
+    /**
+     * @brief Split the slot at the split pointer, moving about half of its entries to a new slot at the end
+     */
+    void split() {
+        const OpTimer timer(this->instrumentation, Op::Split);
+        const uint64_t new_slot = split_ptr + (1ULL << level);
+        slots.emplace_back();
+        auto &chain = slots[split_ptr];
+        std::unordered_map<K, V> entries, moved;
+        for (auto &bucket: chain) {
+            entries.merge(bucket.read_page());
+        }
+        const uint64_t mask = (1ULL << (level + 1)) - 1;
+        for (auto it = entries.begin(); it != entries.end();) {
+            auto next = std::next(it);
+            if ((hash_fn(it->first) & mask) == new_slot) {
+                moved.insert(entries.extract(it));
+            }
+            it = next;
+        }
+        write_chain(chain, std::move(entries));
+        write_chain(slots[new_slot], std::move(moved));
+
+        if (++split_ptr == 1ULL << level) {
+            // all the slots of this round have been split
+            ++level;
+            split_ptr = 0;
+        }
+    }
+
+    /**
+     * @brief Rebuild the bucket chains from their persisted copy, without reading any bucket pages
+     */
+    void load() {
+        const auto words = meta.read();
+        if (words.size() < 5 || words[0] != SCHEME_MAGIC) {
+            throw std::runtime_error("File does not hold a linear hashing scheme");
+        }
+        level = words[1];
+        split_ptr = words[2];
+        num_entries = words[3];
+        slots.assign(words[4], {});
+        // each slot is stored as the chain length, followed by the page IDs of the chain
+        size_t pos = 5;
+        for (auto &buckets: slots) {
+            const auto length = words.at(pos++);
+            for (uint64_t i = 0; i < length; ++i) {
+                buckets.emplace_back(bp, words.at(pos++));
+            }
+        }
+    }
+
+public:
+    /**
+     * @brief Create an empty table with a single slot, or reopen the one stored in the file
+     * The file can't have a write-ahead log, as splits change the slot chains without logging redo records for them.
+     * @param maxLoadFactor Fraction of the capacity of the slots' first buckets that may be used before a split
+     */
+    explicit LinearHashing(BufferPool* bp, HashFn hash_fn = HashFn{}, double maxLoadFactor = 0.8)
+            : max_load_factor(maxLoadFactor), slots(1), bp(bp), hash_fn(std::move(hash_fn)),
+              meta(bp, bp->get_disk_manager()->get_root_page()) {
+        if (bp->get_disk_manager()->has_write_ahead_log()) {
+            throw std::runtime_error("Linear hashing doesn't support the write-ahead log");
+        }
+        if (meta.get_head()) {
+            load();
+            return;
+        }
+        meta = PageChain(bp);
+        bp->get_disk_manager()->set_root_page(meta.get_head());
+    }
+
+    ~LinearHashing() override {
+        save();
+    }
+
+    /**
+     * @brief Persist the bucket chains, so that the table can be reopened from the file
+     */
+    void save() {
+        std::vector<uint64_t> words{SCHEME_MAGIC, level, split_ptr, num_entries, slots.size()};
+        for (auto &buckets: slots) {
+            words.push_back(buckets.size());
+            for (auto &bucket: buckets) {
+                words.push_back(bucket.page_id);
+            }
+        }
+        meta.write(words);
+    }
+
+    uint64_t get_num_slots() const {
+        return slots.size();
+    }
+
+    bool insert(const K &key, const V &value) override {
+        auto &buckets = slots[get_slot(key)];
+
+        for (auto &bucket: buckets) {
+            if (bucket.contains(key))
+                return false;  // already exists
+        }
+
+        if (buckets.empty() || buckets.back().is_full(key, value)) {
+            if (!Bucket<K, V>::fits_empty_page(bp->get_page_size(), key, value)) {
+                // an overflow bucket wouldn't have room for it either
+                throw std::runtime_error("Entry does not fit in a page");
+            }
+            // add an overflow bucket
+            buckets.emplace_back(bp);
+        }
+        if (!buckets.back().insert(key, value)) {
+            return false;
+        }
+        ++num_entries;
+
+        if (load_factor() > max_load_factor) {
+            split();
+        }
+        return true;
+    }
+
+    bool get(const K &key, V* value) override {
+        auto &buckets = slots[get_slot(key)];
+        for (auto &bucket: buckets) {
+            if (bucket.find(key, value))
+                return true;
+        }
+        return false;
+    }
+
+    bool remove(const K &key) override {
+        auto &buckets = slots[get_slot(key)];
+        for (auto iter = buckets.begin(); iter != buckets.end(); ++iter) {
+            auto &bucket = *iter;
+            if (bucket.remove(key)) {
+                if (bucket.is_empty()) {
+                    bp->delete_page(bucket.page_id);
+                    buckets.erase(iter);
+                }
+                --num_entries;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif //LINEARHASHING_HPP
@@ -0,0 +1,166 @@
+#ifndef MMAPDISKMANAGER_HPP
+#define MMAPDISKMANAGER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+#include "DiskManager.hpp"
+
+/**
+ * @brief DiskManager backend which keeps the whole database file mapped in memory
+ * Pages can be accessed in place through map_page, without any copies or syscalls.
+ * A large range of address space is reserved up front and the file is mapped into it as it grows,
+ * so page pointers stay valid when new pages are added, even while other threads are using them.
+ */
+class MmapDiskManager : public DiskManager {
+private:
+    char* base;  // start of the reserved address range, the file is mapped at its beginning
+    std::mutex map_latch;  // serializes changes to the mapping
+    std::atomic<size_t> mapped_size{0};  // number of bytes of the file currently mapped
+    const size_t max_size;  // size of the reserved address range, the file can't grow beyond this
+
+    static size_t round_up(size_t n, size_t multiple) {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    /**
+     * @brief Extend the file and the mapping so that the page can be accessed
+     */
+    void ensure_mapped(IdT page_id) {
+        const size_t needed = (page_id + 1) * page_size;
+        if (needed <= mapped_size) {
+            return;
+        }
+        std::lock_guard guard(map_latch);
+        if (needed <= mapped_size) {
+            return;
+        }
+        // grow geometrically, to keep the number of remaps logarithmic in the file size
+        const size_t new_size = std::min(round_up(std::max(needed, mapped_size.load() * 2), sysconf(_SC_PAGESIZE)),
+                                         max_size);
+        if (needed > new_size) {
+            throw std::runtime_error("Database file too large to map");
+        }
+        if (ftruncate(fd, static_cast<off_t>(new_size)) != 0) {
+            throw std::runtime_error("Unable to grow file");
+        }
+        map(mapped_size, new_size);
+    }
+
+    /**
+     * @brief Map bytes [from, to) of the file into the reserved range
+     */
+    void map(size_t from, size_t to) {
+        void* addr = mmap(base + from, to - from, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                          static_cast<off_t>(from));
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Unable to map file");
+        }
+        mapped_size = to;
+    }
+
+    char* checked_page(IdT page_id) {
+        if ((page_id + 1) * page_size > mapped_size) {
+            throw std::runtime_error("Page not mapped");
+        }
+        return base + page_id * page_size;
+    }
+
+public:
+    explicit MmapDiskManager(const std::string &file_name, uint32_t pageSize = PAGE_SIZE, size_t maxSize = MMAP_MAX_SIZE)
+            : DiskManager(file_name, pageSize, false),
+              max_size(round_up(maxSize, sysconf(_SC_PAGESIZE))) {
+        open();
+        void* addr = mmap(nullptr, max_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Unable to reserve address space");
+        }
+        base = static_cast<char*>(addr);
+        struct stat st{};
+        fstat(fd, &st);
+        const auto file_size = round_up(st.st_size, sysconf(_SC_PAGESIZE));
+        if (file_size) {
+            if (file_size != static_cast<size_t>(st.st_size) && ftruncate(fd, static_cast<off_t>(file_size)) != 0) {
+                throw std::runtime_error("Unable to grow file");
+            }
+            map(0, std::min(file_size, max_size));
+        }
+        load_superblock();
+    }
+
+    ~MmapDiskManager() override {
+        save_superblock();
+        if (mapped_size) {
+            msync(base, mapped_size, MS_SYNC);
+        }
+        munmap(base, max_size);
+        // give back the space added by geometric growth
+        if (ftruncate(fd, static_cast<off_t>((last_used_page + 1) * page_size)) != 0) {
+            // the file is still valid, only larger than needed
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    IdT new_page() override {
+        const IdT page_id = DiskManager::new_page();
+        ensure_mapped(page_id);
+        return page_id;
+    }
+
+    char* map_page(IdT page_id) override {
+        return checked_page(page_id);
+    }
+
+    bool maps_pages() const override {
+        return true;
+    }
+
+protected:
+    void read_bytes(IdT page_id, size_t n, char* data) override {
+        memcpy(data, checked_page(page_id), n);
+    }
+
+    void write_bytes(IdT page_id, const char* page_data) override {
+        ensure_mapped(page_id);
+        memcpy(checked_page(page_id), page_data, page_size);
+    }
+
+    /**
+     * @brief Shrink the file, returning the unmapped tail of the mapping to the reservation
+     */
+    void truncate_file(uint64_t size) override {
+        std::lock_guard guard(map_latch);
+        const size_t new_size = round_up(size, sysconf(_SC_PAGESIZE));
+        if (new_size < mapped_size) {
+            msync(base + new_size, mapped_size - new_size, MS_SYNC);
+            void* addr = mmap(base + new_size, mapped_size - new_size, PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+            if (addr == MAP_FAILED) {
+                throw std::runtime_error("Unable to unmap file");
+            }
+            mapped_size = new_size;
+        }
+        // keep the file as large as the mapping, so that writes to the mapped pages reach it
+        if (ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+            throw std::runtime_error("Unable to truncate file");
+        }
+    }
+
+    void flush_file() override {
+        if (mapped_size && msync(base, mapped_size, MS_SYNC) != 0) {
+            throw std::runtime_error("Unable to sync file");
+        }
+    }
+};
+
+#endif //MMAPDISKMANAGER_HPP
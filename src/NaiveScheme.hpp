@@ -3,7 +3,7 @@
 
 #include <list>
 
-#include "DiskManager.hpp"
+#include "BufferPool.hpp"
 #include "HashingScheme.hpp"
 #include "Bucket.hpp"
 
@@ -12,14 +12,14 @@
  */
 template<typename K, typename V>
 class NaiveScheme : public HashingScheme<K, V> {
-    DiskManager* dm;
+    BufferPool* bp;
     std::list<Bucket<K, V>> buckets;
 public:
-    NaiveScheme(DiskManager* dm) : dm(dm) {}
+    NaiveScheme(BufferPool* bp) : bp(bp) {}
 
     bool insert(const K &key, const V &value) override {
-        if (buckets.empty() || buckets.back().is_full()) {
-            buckets.emplace_back(dm);
+        if (buckets.empty() || buckets.back().is_full(key, value)) {
+            buckets.emplace_back(bp);
         }
         return buckets.back().insert(key, value);
     }
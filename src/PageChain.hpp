@@ -0,0 +1,123 @@
+#ifndef PAGECHAIN_HPP
+#define PAGECHAIN_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "common.h"
+#include "BufferPool.hpp"
+
+/**
+ * @brief Stores a variable number of 64 bit words in a linked list of pages
+ * Used by the hashing schemes to persist their directory and other metadata.
+ * Each page starts with a ChainHeader, followed by the words stored in it.
+ */
+class PageChain {
+private:
+    struct ChainHeader {
+        IdT next_page;  // 0 for the last page of the chain
+        uint64_t num_words;  // number of words stored in this page
+    };
+
+    BufferPool* bp;
+    IdT head;
+
+    size_t words_per_page() const {
+        return (bp->get_page_size() - sizeof(ChainHeader)) / sizeof(uint64_t);
+    }
+
+    static ChainHeader read_header(const char* page_data) {
+        ChainHeader header{};
+        memcpy(&header, page_data, sizeof(ChainHeader));
+        return header;
+    }
+
+    /**
+     * @brief Free all the pages of the chain, starting from page_id
+     */
+    void free_from(IdT page_id) {
+        while (page_id) {
+            IdT next_page;
+            {
+                PageGuard page(bp, page_id);
+                next_page = read_header(page.data()).next_page;
+            }
+            bp->delete_page(page_id);
+            page_id = next_page;
+        }
+    }
+
+public:
+    /**
+     * @brief Open an existing chain
+     * @param head First page of the chain, a zero filled page is a valid empty chain
+     */
+    PageChain(BufferPool* bp, IdT head) : bp(bp), head(head) {}
+
+    /**
+     * @brief Create an empty chain on a new page
+     */
+    explicit PageChain(BufferPool* bp) : PageChain(bp, bp->new_page()) {}
+
+    IdT get_head() const {
+        return head;
+    }
+
+    std::vector<uint64_t> read() {
+        std::vector<uint64_t> words;
+        IdT page_id = head;
+        while (page_id) {
+            PageGuard page(bp, page_id);
+            const auto header = read_header(page.data());
+            const auto start = words.size();
+            words.resize(start + header.num_words);
+            if (header.num_words) {
+                memcpy(words.data() + start, page.data() + sizeof(ChainHeader), header.num_words * sizeof(uint64_t));
+            }
+            page_id = header.next_page;
+        }
+        return words;
+    }
+
+    /**
+     * @brief Replace the contents of the chain, reusing its existing pages
+     * Pages are added to or removed from the end of the chain as needed.
+     */
+    void write(const std::vector<uint64_t> &words) {
+        IdT page_id = head;
+        size_t pos = 0;
+        while (true) {
+            PageGuard page(bp, page_id);
+            ChainHeader header = read_header(page.data());
+            const size_t n = std::min(words_per_page(), words.size() - pos);
+            const bool more = pos + n < words.size();
+            if (more && !header.next_page) {
+                header.next_page = bp->new_page();
+            } else if (!more && header.next_page) {
+                free_from(header.next_page);
+                header.next_page = 0;
+            }
+            header.num_words = n;
+            char* page_data = page.mutable_data();
+            memcpy(page_data, &header, sizeof(ChainHeader));
+            if (n) {
+                memcpy(page_data + sizeof(ChainHeader), words.data() + pos, n * sizeof(uint64_t));
+            }
+            pos += n;
+            if (!more) {
+                break;
+            }
+            page_id = header.next_page;
+        }
+    }
+
+    /**
+     * @brief Free all the pages of the chain, including the head
+     */
+    void destroy() {
+        free_from(head);
+        head = 0;
+    }
+};
+
+#endif //PAGECHAIN_HPP
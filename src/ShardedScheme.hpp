@@ -0,0 +1,287 @@
+#ifndef SHARDEDSCHEME_HPP
+#define SHARDEDSCHEME_HPP
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "BufferPool.hpp"
+#include "DiskManager.hpp"
+#include "Hashes.hpp"
+#include "HashingScheme.hpp"
+
+/**
+ * @brief Hash partition the keys over several inner schemes, each with its own file, buffer pool and latch
+ * Operations on different shards run in parallel, so putting the files on different devices and using the scheme from
+ * several threads spreads the load over all of them. Batched operations are split by shard, and with per-shard threads
+ * the parts run on all the shards at once.
+ * Keys are assigned by their hash, so a set of shard files must always be reopened with the same files in the same
+ * order, and the same hash function.
+ * @tparam Inner Scheme used by every shard
+ */
+template<typename K, typename V, typename Inner, typename Hash = DefaultHash<K>>
+class ShardedScheme : public HashingScheme<K, V> {
+public:
+    using Factory = std::function<std::unique_ptr<Inner>(BufferPool*)>;  // creates or reopens the scheme of a shard
+
+private:
+    struct Shard {
+        std::unique_ptr<DiskManager> dm;
+        std::unique_ptr<BufferPool> bp;
+        std::unique_ptr<Inner> scheme;
+        std::mutex latch;  // guards the scheme and its buffer pool
+
+        // tasks for the thread of the shard, if it has one
+        std::mutex queue_latch;
+        std::condition_variable queue_changed;
+        std::deque<std::packaged_task<void()>> tasks;
+        bool stopping{false};
+        std::thread worker;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    [[no_unique_address]] Hash hash_fn;
+    std::mutex found_latch;  // guards the found flags of multi_get while the shards fill them in
+
+    /**
+     * @brief Pick the shard of a key
+     * The hash is mixed again first, as the inner schemes pick buckets by the same hash, and should see all of its
+     * bits vary among the keys of a shard.
+     */
+    size_t get_shard(const K &key) const {
+        return Hashes::fmix64(hash_fn(key) ^ 0x5348415244) % shards.size();
+    }
+
+    static void work(Shard &shard) {
+        for (;;) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock lock(shard.queue_latch);
+                shard.queue_changed.wait(lock, [&] { return !shard.tasks.empty() || shard.stopping; });
+                if (shard.tasks.empty()) {
+                    return;
+                }
+                task = std::move(shard.tasks.front());
+                shard.tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    /**
+     * @brief Call fn(shard, positions) for each shard holding some of the keys, with the positions of its keys
+     * The calls run on the threads of the shards if they have them, and on the calling thread otherwise, in both
+     * cases with the latch of the shard held.
+     */
+    template<typename Fn>
+    void for_each_shard(std::span<const K> keys, Fn fn) {
+        std::vector<std::vector<size_t>> positions(shards.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            positions[get_shard(keys[i])].push_back(i);
+        }
+        std::vector<std::future<void>> pending;
+        for (size_t s = 0; s < shards.size(); ++s) {
+            if (positions[s].empty()) {
+                continue;
+            }
+            Shard &shard = *shards[s];
+            auto run = [&fn, &shard, &idxs = positions[s]] {
+                std::lock_guard guard(shard.latch);
+                fn(*shard.scheme, std::span<const size_t>(idxs));
+            };
+            if (!shard.worker.joinable()) {
+                run();
+                continue;
+            }
+            std::packaged_task<void()> task(run);
+            pending.push_back(task.get_future());
+            {
+                std::lock_guard guard(shard.queue_latch);
+                shard.tasks.push_back(std::move(task));
+            }
+            shard.queue_changed.notify_one();
+        }
+        // wait for all of the shards before rethrowing, their tasks refer to this frame
+        for (auto &done: pending) {
+            done.wait();
+        }
+        for (auto &done: pending) {
+            done.get();
+        }
+    }
+
+public:
+    /**
+     * @brief Create or reopen the shards, one per file
+     * @param files Files of the shards, which can be on different devices
+     * @param makeShard Creates the scheme of a shard given its buffer pool, or reopens the one stored in its file. If
+     * not given, Inner is constructed from the buffer pool alone.
+     * @param shardThreads Give each shard a thread to run its part of the batched operations, so that they run in
+     * parallel
+     * @param framesPerShard Size of the buffer pool of each shard
+     */
+    explicit ShardedScheme(const std::vector<std::string> &files, Factory makeShard = nullptr,
+                           bool shardThreads = false, uint32_t pageSize = PAGE_SIZE,
+                           size_t framesPerShard = BUFFER_POOL_FRAMES, Hash hash = Hash{})
+            : hash_fn(std::move(hash)) {
+        if (files.empty()) {
+            throw std::runtime_error("Need at least one shard");
+        }
+        if (!makeShard) {
+            if constexpr (std::constructible_from<Inner, BufferPool*>) {
+                makeShard = [](BufferPool* bp) { return std::make_unique<Inner>(bp); };
+            } else {
+                throw std::runtime_error("Inner scheme needs more than a buffer pool, pass a factory");
+            }
+        }
+        for (const auto &file: files) {
+            auto shard = std::make_unique<Shard>();
+            shard->dm = std::make_unique<DiskManager>(file, pageSize);
+            shard->bp = std::make_unique<BufferPool>(shard->dm.get(), framesPerShard);
+            shard->scheme = makeShard(shard->bp.get());
+            shards.push_back(std::move(shard));
+        }
+        if (shardThreads) {
+            for (auto &shard: shards) {
+                shard->worker = std::thread(&ShardedScheme::work, std::ref(*shard));
+            }
+        }
+    }
+
+    ~ShardedScheme() override {
+        for (auto &shard: shards) {
+            {
+                std::lock_guard guard(shard->queue_latch);
+                shard->stopping = true;
+            }
+            shard->queue_changed.notify_all();
+            if (shard->worker.joinable()) {
+                shard->worker.join();
+            }
+        }
+    }
+
+    size_t num_shards() const {
+        return shards.size();
+    }
+
+    /**
+     * @brief Get the scheme of a shard, which must not be used while other threads use this scheme
+     */
+    Inner &get_shard_scheme(size_t shard) {
+        return *shards[shard]->scheme;
+    }
+
+    DiskManager* get_disk_manager(size_t shard) const {
+        return shards[shard]->dm.get();
+    }
+
+    BufferPool* get_buffer_pool(size_t shard) const {
+        return shards[shard]->bp.get();
+    }
+
+    /**
+     * @brief Flush the pages of every shard to its file
+     */
+    void sync() {
+        for (auto &shard: shards) {
+            std::lock_guard guard(shard->latch);
+            shard->bp->sync();
+        }
+    }
+
+    void set_instrumentation(Instrumentation* instr) override {
+        this->instrumentation = instr;
+        for (auto &shard: shards) {
+            std::lock_guard guard(shard->latch);
+            shard->scheme->set_instrumentation(instr);
+        }
+    }
+
+    bool insert(const K &key, const V &value) override {
+        Shard &shard = *shards[get_shard(key)];
+        std::lock_guard guard(shard.latch);
+        return shard.scheme->insert(key, value);
+    }
+
+    bool get(const K &key, V* value) override {
+        Shard &shard = *shards[get_shard(key)];
+        std::lock_guard guard(shard.latch);
+        return shard.scheme->get(key, value);
+    }
+
+    bool remove(const K &key) override {
+        Shard &shard = *shards[get_shard(key)];
+        std::lock_guard guard(shard.latch);
+        return shard.scheme->remove(key);
+    }
+
+    size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) override {
+        this->check_batch(keys.size(), values.size());
+        found.assign(keys.size(), false);
+        std::atomic<size_t> num_found{0};
+        for_each_shard(keys, [&](Inner &scheme, std::span<const size_t> idxs) {
+            std::vector<K> shard_keys;
+            shard_keys.reserve(idxs.size());
+            for (const auto i: idxs) {
+                shard_keys.push_back(keys[i]);
+            }
+            std::vector<V> shard_values(idxs.size());
+            std::vector<bool> shard_found;
+            num_found += scheme.multi_get(shard_keys, shard_values, shard_found);
+            for (size_t j = 0; j < idxs.size(); ++j) {
+                if (shard_found[j]) {
+                    values[idxs[j]] = shard_values[j];
+                }
+            }
+            // std::vector<bool> packs its elements, so shards can't write into found at once
+            std::lock_guard guard(found_latch);
+            for (size_t j = 0; j < idxs.size(); ++j) {
+                found[idxs[j]] = shard_found[j];
+            }
+        });
+        return num_found;
+    }
+
+    size_t multi_insert(std::span<const K> keys, std::span<const V> values) override {
+        this->check_batch(keys.size(), values.size());
+        std::atomic<size_t> num_inserted{0};
+        for_each_shard(keys, [&](Inner &scheme, std::span<const size_t> idxs) {
+            std::vector<K> shard_keys;
+            std::vector<V> shard_values;
+            shard_keys.reserve(idxs.size());
+            shard_values.reserve(idxs.size());
+            for (const auto i: idxs) {
+                shard_keys.push_back(keys[i]);
+                shard_values.push_back(values[i]);
+            }
+            num_inserted += scheme.multi_insert(shard_keys, shard_values);
+        });
+        return num_inserted;
+    }
+
+    size_t multi_remove(std::span<const K> keys) override {
+        std::atomic<size_t> num_removed{0};
+        for_each_shard(keys, [&](Inner &scheme, std::span<const size_t> idxs) {
+            std::vector<K> shard_keys;
+            shard_keys.reserve(idxs.size());
+            for (const auto i: idxs) {
+                shard_keys.push_back(keys[i]);
+            }
+            num_removed += scheme.multi_remove(shard_keys);
+        });
+        return num_removed;
+    }
+};
+
+#endif //SHARDEDSCHEME_HPP
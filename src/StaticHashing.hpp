@@ -1,22 +1,35 @@
 #ifndef STATICHASHING_HPP
 #define STATICHASHING_HPP
 
+#include <algorithm>
 #include <functional>
 #include <list>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <unordered_set>
 #include <vector>
 
 #include "Bucket.hpp"
-#include "DiskManager.hpp"
+#include "BufferPool.hpp"
+#include "Hashes.hpp"
 #include "HashingScheme.hpp"
+#include "PageChain.hpp"
 
-template<typename K, typename V>
+/**
+ * @tparam Hash Hash function, called directly so that it can be inlined. Use HashFunction<K> to pick one at runtime.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
 class StaticHashing : public HashingScheme<K, V> {
-    using HashFn = std::function<uint64_t(K)>;  // hash function type
+    using HashFn = Hash;  // hash function type
+    static constexpr uint64_t SCHEME_MAGIC = 0x0048534148545453;  // "STTHASH"
+    static constexpr uint64_t REDO_CHAIN = 1;  // redo record of a changed chain: slot, length, page IDs of the chain
 private:
     uint64_t num_slots;
     std::vector<std::list<Bucket<K, V>>> slots;
-    DiskManager* dm;
-    HashFn hash_fn;
+    BufferPool* bp;
+    [[no_unique_address]] HashFn hash_fn;
+    PageChain meta;  // persisted copy of the bucket chains
 
     /**
      * @brief Get a reference to the entire bucket chain for a given key
@@ -29,11 +42,133 @@ private:
         return slots[slot];
     }
 
+    /**
+     * @brief Call fn(chain, positions) once for each bucket chain holding some of the keys, with the positions of its
+     * keys in increasing order. The pages of each chain are prefetched before calling fn.
+     */
+    template<typename Fn>
+    void for_each_chain(std::span<const K> keys, Fn fn) {
+        std::vector<size_t> dest(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            dest[i] = hash_fn(keys[i]) % num_slots;
+        }
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return dest[a] < dest[b]; });
+        for (size_t start = 0, end; start < order.size(); start = end) {
+            for (end = start + 1; end < order.size() && dest[order[end]] == dest[order[start]]; ++end);
+            auto &buckets = slots[dest[order[start]]];
+            prefetch_chain(buckets);
+            fn(buckets, std::span<const size_t>(order).subspan(start, end - start));
+        }
+    }
+
+    /**
+     * @brief Start reading all the pages of a chain at once, instead of one at a time while walking it
+     */
+    void prefetch_chain(const std::list<Bucket<K, V>> &buckets) {
+        if (buckets.size() < 2) {
+            return;
+        }
+        std::vector<IdT> page_ids;
+        page_ids.reserve(buckets.size());
+        for (const auto &bucket: buckets) {
+            page_ids.push_back(bucket.page_id);
+        }
+        bp->prefetch(page_ids);
+    }
+
+    /**
+     * @brief Log the pages of a chain after a bucket was added to it or removed from it, if there is a write-ahead log
+     */
+    void log_chain(const std::list<Bucket<K, V>> &buckets) {
+        auto* dm = bp->get_disk_manager();
+        if (!dm->has_write_ahead_log()) {
+            return;
+        }
+        std::vector<uint64_t> record{REDO_CHAIN, static_cast<uint64_t>(&buckets - slots.data()), buckets.size()};
+        for (const auto &bucket: buckets) {
+            record.push_back(bucket.page_id);
+        }
+        dm->log_redo(record);
+    }
+
+    /**
+     * @brief Drop the positions which have been handled
+     */
+    static void drop_done(std::vector<size_t> &idxs, const std::vector<bool> &done) {
+        std::erase_if(idxs, [&](size_t i) { return done[i]; });
+    }
+
+    /**
+     * @brief Rebuild the bucket chains from their persisted copy, without reading any bucket pages
+     */
+    void load() {
+        const auto words = meta.read();
+        if (words.size() < 2 || words[0] != SCHEME_MAGIC) {
+            throw std::runtime_error("File does not hold a static hashing scheme");
+        }
+        num_slots = words[1];
+        slots.assign(num_slots, {});
+        // each slot is stored as the chain length, followed by the page IDs of the chain
+        size_t pos = 2;
+        for (auto &buckets: slots) {
+            const auto length = words.at(pos++);
+            for (uint64_t i = 0; i < length; ++i) {
+                buckets.emplace_back(bp, words.at(pos++));
+            }
+        }
+        // chains changed since they were saved
+        for (const auto &record: bp->get_disk_manager()->get_redo_records()) {
+            if (record.size() < 3 || record[0] != REDO_CHAIN || record.size() != 3 + record[2]) {
+                throw std::runtime_error("Corrupt redo record");
+            }
+            auto &buckets = slots.at(record[1]);
+            buckets.clear();
+            for (size_t i = 3; i < record.size(); ++i) {
+                buckets.emplace_back(bp, record[i]);
+            }
+        }
+    }
+
 public:
-    explicit StaticHashing(uint64_t numSlots, DiskManager* dm, HashFn hash_fn = std::hash<K>{}) : num_slots(numSlots),
-                                                                                                  slots(numSlots),
-                                                                                                  dm(dm),
-                                                                                                  hash_fn(hash_fn) {}
+    /**
+     * @brief Create an empty table, or reopen the one stored in the file
+     * @param numSlots Number of slots for a new table, a reopened table keeps the number it was created with
+     */
+    explicit StaticHashing(uint64_t numSlots, BufferPool* bp, HashFn hash_fn = HashFn{})
+            : num_slots(numSlots), slots(numSlots), bp(bp), hash_fn(std::move(hash_fn)),
+              meta(bp, bp->get_disk_manager()->get_root_page()) {
+        if (meta.get_head()) {
+            load();
+            return;
+        }
+        meta = PageChain(bp);
+        bp->get_disk_manager()->set_root_page(meta.get_head());
+        if (bp->get_disk_manager()->has_write_ahead_log()) {
+            // redo records are replayed on top of saved chains, so start with them
+            save();
+        }
+    }
+
+    ~StaticHashing() override {
+        save();
+    }
+
+    /**
+     * @brief Persist the bucket chains, so that the table can be reopened from the file
+     */
+    void save() {
+        std::vector<uint64_t> words{SCHEME_MAGIC, num_slots};
+        for (auto &buckets: slots) {
+            words.push_back(buckets.size());
+            for (auto &bucket: buckets) {
+                words.push_back(bucket.page_id);
+            }
+        }
+        meta.write(words);
+        bp->get_disk_manager()->clear_redo();
+    }
 
 
     bool insert(const K &key, const V &value) override {
@@ -46,16 +181,93 @@ public:
         }
 
         // check if no buckets or if last bucket full
-        if (buckets.empty() || buckets.back().is_full()) {
+        if (buckets.empty() || buckets.back().is_full(key, value)) {
+            if (!Bucket<K, V>::fits_empty_page(bp->get_page_size(), key, value)) {
+                // a new bucket wouldn't have room for it either
+                throw std::runtime_error("Entry does not fit in a page");
+            }
             // add a new bucket
-            buckets.emplace_back(dm);
+            buckets.emplace_back(bp);
+            log_chain(buckets);
         }
 
-        return buckets.back().insert(key, value);
+        const bool inserted = buckets.back().insert(key, value);
+        bp->end_operation();
+        return inserted;
+    }
+
+    size_t multi_get(std::span<const K> keys, std::span<V> values, std::vector<bool> &found) override {
+        this->check_batch(keys.size(), values.size());
+        found.assign(keys.size(), false);
+        size_t num_found = 0;
+        for_each_chain(keys, [&](std::list<Bucket<K, V>> &buckets, std::span<const size_t> chain_idxs) {
+            std::vector<size_t> idxs(chain_idxs.begin(), chain_idxs.end());
+            for (auto iter = buckets.begin(); iter != buckets.end() && !idxs.empty(); ++iter) {
+                num_found += iter->find_batch(keys, idxs, values, found);
+                drop_done(idxs, found);
+            }
+        });
+        return num_found;
+    }
+
+    size_t multi_insert(std::span<const K> keys, std::span<const V> values) override {
+        this->check_batch(keys.size(), values.size());
+        std::vector<V> existing(keys.size());
+        std::vector<bool> present(keys.size(), false);
+        size_t num_inserted = 0;
+        for_each_chain(keys, [&](std::list<Bucket<K, V>> &buckets, std::span<const size_t> chain_idxs) {
+            // skip the keys already in the chain, and repeated keys of the batch
+            std::vector<size_t> idxs(chain_idxs.begin(), chain_idxs.end());
+            for (auto iter = buckets.begin(); iter != buckets.end() && !idxs.empty(); ++iter) {
+                iter->find_batch(keys, idxs, existing, present);
+                drop_done(idxs, present);
+            }
+            std::unordered_set<K> seen;
+            std::erase_if(idxs, [&](size_t i) { return !seen.insert(keys[i]).second; });
+
+            std::span<const size_t> rest(idxs);
+            while (!rest.empty()) {
+                const K &key = keys[rest.front()];
+                const V &value = values[rest.front()];
+                if (buckets.empty() || buckets.back().is_full(key, value)) {
+                    if (!Bucket<K, V>::fits_empty_page(bp->get_page_size(), key, value)) {
+                        // not even an empty bucket has room for it
+                        throw std::runtime_error("Entry does not fit in a page");
+                    }
+                    buckets.emplace_back(bp);
+                    log_chain(buckets);
+                }
+                rest = rest.subspan(buckets.back().insert_batch(keys, values, rest, num_inserted));
+            }
+        });
+        bp->end_operation();
+        return num_inserted;
+    }
+
+    size_t multi_remove(std::span<const K> keys) override {
+        std::vector<bool> removed(keys.size(), false);
+        size_t num_removed = 0;
+        for_each_chain(keys, [&](std::list<Bucket<K, V>> &buckets, std::span<const size_t> chain_idxs) {
+            std::vector<size_t> idxs(chain_idxs.begin(), chain_idxs.end());
+            for (auto iter = buckets.begin(); iter != buckets.end() && !idxs.empty();) {
+                num_removed += iter->remove_batch(keys, idxs, removed);
+                drop_done(idxs, removed);
+                if (iter->is_empty()) {
+                    bp->delete_page(iter->page_id);
+                    iter = buckets.erase(iter);
+                    log_chain(buckets);
+                } else {
+                    ++iter;
+                }
+            }
+        });
+        bp->end_operation();
+        return num_removed;
     }
 
     bool get(const K &key, V* value) override {
         auto &buckets = get_bucket_chain(key);
+        prefetch_chain(buckets);
         for (auto &bucket: buckets) {
             if (bucket.find(key, value))
                 return true;
@@ -69,9 +281,11 @@ public:
             auto &bucket = *iter;
             if (bucket.remove(key)) {
                 if (bucket.is_empty()) {
-                    dm->remove_page(bucket.page_id);
+                    bp->delete_page(bucket.page_id);
                     buckets.erase(iter);
+                    log_chain(buckets);
                 }
+                bp->end_operation();
                 return true;
             }
         }
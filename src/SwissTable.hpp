@@ -0,0 +1,160 @@
+#ifndef SWISSTABLE_HPP
+#define SWISSTABLE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include "Hashes.hpp"
+#include "HashingScheme.hpp"
+#include "TagGroup.hpp"
+
+/**
+ * @brief In-memory open addressing hash table, in the style of the Swiss tables
+ * The slots are split into groups of TagGroup::WIDTH, and every slot has a control byte holding the tag of its key,
+ * or a marker for an empty or deleted slot. A lookup probes one group at a time, comparing the tag of the key with
+ * all the control bytes of the group at once, and only compares the keys of the slots with a matching tag.
+ * Probing stops at the first group with an empty slot.
+ * @tparam Hash Hash function, called directly so that it can be inlined. Use HashFunction<K> to pick one at runtime.
+ */
+template<typename K, typename V, typename Hash = DefaultHash<K>>
+class SwissTable : public HashingScheme<K, V> {
+    using HashFn = Hash;  // hash function type
+    static constexpr uint64_t MAX_LOAD_NUM = 7, MAX_LOAD_DEN = 8;  // grow once 7/8 of the slots are used
+
+    [[no_unique_address]] HashFn hash_fn;
+    uint64_t num_groups;  // always a power of 2
+    uint64_t num_entries{0};
+    uint64_t num_deleted{0};
+    std::vector<int8_t> ctrl;  // control byte of each slot
+    std::vector<K> keys;
+    std::vector<V> values;
+
+    /**
+     * @brief Follow the probe sequence of the mixed hash, calling fn(group) till it returns true
+     * Groups are visited in triangular steps, which reach every group as their number is a power of 2.
+     */
+    template<typename Fn>
+    void probe(uint64_t hash, Fn fn) const {
+        uint64_t group = hash & (num_groups - 1);
+        for (uint64_t step = 1; !fn(group); ++step) {
+            group = (group + step) & (num_groups - 1);
+        }
+    }
+
+    /**
+     * @return Index of the slot holding the key, or -1 if absent
+     */
+    int64_t find_slot(const K &key) const {
+        const uint64_t hash = TagGroup::mix(hash_fn(key));
+        const int8_t tag = TagGroup::tag(hash);
+        int64_t found = -1;
+        probe(hash, [&](uint64_t group) {
+            const int8_t* tags = ctrl.data() + group * TagGroup::WIDTH;
+            for (uint32_t mask = TagGroup::match(tags, tag); mask; mask &= mask - 1) {
+                const uint64_t slot = group * TagGroup::WIDTH + std::countr_zero(mask);
+                if (keys[slot] == key) {
+                    found = static_cast<int64_t>(slot);
+                    return true;
+                }
+            }
+            // the key would have been placed in this group if it had been inserted
+            return TagGroup::match_empty(tags) != 0;
+        });
+        return found;
+    }
+
+    /**
+     * @brief Put an entry which isn't in the table into the first free slot of its probe sequence
+     */
+    void place(K &&key, V &&value) {
+        const uint64_t hash = TagGroup::mix(hash_fn(key));
+        probe(hash, [&](uint64_t group) {
+            const uint32_t mask = TagGroup::match_empty_or_deleted(ctrl.data() + group * TagGroup::WIDTH);
+            if (!mask) {
+                return false;
+            }
+            const uint64_t slot = group * TagGroup::WIDTH + std::countr_zero(mask);
+            num_deleted -= ctrl[slot] == TagGroup::DELETED;
+            ctrl[slot] = TagGroup::tag(hash);
+            keys[slot] = std::move(key);
+            values[slot] = std::move(value);
+            return true;
+        });
+        ++num_entries;
+    }
+
+    /**
+     * @brief Move all entries to a table with the given number of groups, dropping the deleted slots
+     */
+    void rehash(uint64_t new_num_groups) {
+        const OpTimer timer(this->instrumentation, Op::Grow);
+        auto old_ctrl = std::move(ctrl);
+        auto old_keys = std::move(keys);
+        auto old_values = std::move(values);
+        num_groups = new_num_groups;
+        ctrl.assign(num_groups * TagGroup::WIDTH, TagGroup::EMPTY);
+        keys.assign(num_groups * TagGroup::WIDTH, K{});
+        values.assign(num_groups * TagGroup::WIDTH, V{});
+        num_entries = num_deleted = 0;
+        for (size_t slot = 0; slot < old_ctrl.size(); ++slot) {
+            if (old_ctrl[slot] >= 0) {
+                place(std::move(old_keys[slot]), std::move(old_values[slot]));
+            }
+        }
+    }
+
+public:
+    /**
+     * @param numSlots Number of entries to make room for up front
+     */
+    explicit SwissTable(HashFn hash_fn = HashFn{}, uint64_t numSlots = 0) : hash_fn(std::move(hash_fn)), num_groups(0) {
+        const uint64_t groups = (numSlots * MAX_LOAD_DEN / MAX_LOAD_NUM + TagGroup::WIDTH - 1) / TagGroup::WIDTH;
+        rehash(std::bit_ceil(std::max<uint64_t>(groups, 1)));
+    }
+
+    uint64_t size() const {
+        return num_entries;
+    }
+
+    bool insert(const K &key, const V &value) override {
+        if (find_slot(key) >= 0) {
+            return false;
+        }
+        if ((num_entries + num_deleted + 1) * MAX_LOAD_DEN > ctrl.size() * MAX_LOAD_NUM) {
+            // only grow if the table is really full, otherwise reclaiming the deleted slots is enough
+            rehash(num_entries * 2 >= ctrl.size() * MAX_LOAD_NUM / MAX_LOAD_DEN ? num_groups * 2 : num_groups);
+        }
+        place(K(key), V(value));
+        return true;
+    }
+
+    bool get(const K &key, V* value) override {
+        const auto slot = find_slot(key);
+        if (slot < 0) {
+            return false;
+        }
+        *value = values[slot];
+        return true;
+    }
+
+    bool remove(const K &key) override {
+        const auto slot = find_slot(key);
+        if (slot < 0) {
+            return false;
+        }
+        // if the group has an empty slot, no probe sequence continues past it, so the slot can be emptied
+        // otherwise some keys after this group might have passed through it, and probing must not stop here
+        const int8_t* tags = ctrl.data() + slot / TagGroup::WIDTH * TagGroup::WIDTH;
+        if (TagGroup::match_empty(tags)) {
+            ctrl[slot] = TagGroup::EMPTY;
+        } else {
+            ctrl[slot] = TagGroup::DELETED;
+            ++num_deleted;
+        }
+        --num_entries;
+        return true;
+    }
+};
+
+#endif //SWISSTABLE_HPP
@@ -0,0 +1,73 @@
+#ifndef TAGGROUP_HPP
+#define TAGGROUP_HPP
+
+#include <cstdint>
+#include "Hashes.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Operations on groups of 16 one byte tags, compared all at once with SSE2 where available
+ * A tag holds 7 bits of the hash of a key, so most keys can be ruled out without comparing them.
+ * Negative tags are reserved for marking empty and deleted slots.
+ */
+struct TagGroup {
+    static constexpr uint32_t WIDTH = 16;
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    /**
+     * @brief Spread the entropy of a hash over all of its bits (murmur3 finalizer), so that weak hashes work too
+     */
+    static uint64_t mix(uint64_t hash) {
+        return Hashes::fmix64(hash);
+    }
+
+    /**
+     * @brief Get the tag for a mixed hash, from its top bits so that the low bits can be used to pick a slot
+     */
+    static int8_t tag(uint64_t mixed_hash) {
+        return static_cast<int8_t>(mixed_hash >> 57);
+    }
+
+    /**
+     * @brief Find the tags in the group which are equal to the given one
+     * @param tags WIDTH readable bytes
+     * @return Bit mask with bit i set if tags[i] == tag
+     */
+    static uint32_t match(const int8_t* tags, int8_t tag) {
+#ifdef __SSE2__
+        const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < WIDTH; ++i) {
+            mask |= static_cast<uint32_t>(tags[i] == tag) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static uint32_t match_empty(const int8_t* tags) {
+        return match(tags, EMPTY);
+    }
+
+    /**
+     * @brief Find the slots of the group which can be used for a new key
+     */
+    static uint32_t match_empty_or_deleted(const int8_t* tags) {
+#ifdef __SSE2__
+        // only the reserved tags have the sign bit set
+        return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tags)));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < WIDTH; ++i) {
+            mask |= static_cast<uint32_t>(tags[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+};
+
+#endif //TAGGROUP_HPP
@@ -0,0 +1,267 @@
+#ifndef WRITEAHEADLOG_HPP
+#define WRITEAHEADLOG_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+#include "Hashes.hpp"
+
+/**
+ * @brief Redo log of a database file, making a batch of page writes and structural changes atomic and durable
+ * The changes of a batch are held in memory till commit() appends them to the log as a single frame, followed by one
+ * fdatasync of the log. A frame holds the last image of every page written in the batch, and the redo records of the
+ * hashing scheme, which describe changes to its in-memory metadata that are not saved to pages yet, like the directory
+ * entries updated by a split. Recovery replays the frames which were written in full, and ignores a torn last one.
+ * Each frame starts with a FrameHeader, followed by its records, each a RecordHeader and its bytes padded to 8 bytes.
+ */
+class WriteAheadLog {
+private:
+    static constexpr uint64_t FRAME_MAGIC = 0x4C41574844424B52;  // "RKDBHWAL"
+
+    enum RecordKind : uint64_t {
+        PAGE = 1,  // after-image of a page
+        REDO = 2,  // redo record of the scheme
+        CLEAR_REDO = 3,  // the scheme saved its metadata, the redo records before this one are not needed anymore
+    };
+
+    struct FrameHeader {
+        uint64_t magic;
+        uint64_t sequence;  // one more than the sequence of the frame before it
+        uint64_t size;  // bytes of records following the header
+        uint64_t checksum;  // CRC32C of the sequence, size and records
+    };
+
+    struct RecordHeader {
+        uint64_t kind;
+        uint64_t id;  // page ID of a page image
+        uint64_t size;  // bytes of the record, not counting the padding
+    };
+
+    int fd{-1};
+    const std::string file_name;
+    const uint32_t page_size;
+    uint64_t end{0};  // size of the log
+    uint64_t next_sequence{1};
+
+    std::map<IdT, std::vector<char>> pages;  // last image of each page written since the last commit, by page ID
+    std::vector<char> records;  // encoded redo records logged since the last commit
+
+    static void append(std::vector<char> &out, RecordKind kind, uint64_t id, const void* data, uint64_t size) {
+        const RecordHeader header{kind, id, size};
+        const size_t pos = out.size();
+        out.resize(pos + sizeof(RecordHeader) + (size + 7) / 8 * 8);
+        memcpy(out.data() + pos, &header, sizeof(RecordHeader));
+        if (size) {
+            memcpy(out.data() + pos + sizeof(RecordHeader), data, size);
+        }
+    }
+
+    static uint64_t checksum(uint64_t sequence, std::span<const char> payload) {
+        const uint64_t fields[2]{sequence, payload.size()};
+        const auto crc = Hashes::crc32c(reinterpret_cast<const char*>(fields), sizeof(fields));
+        return Hashes::crc32c(payload.data(), payload.size(), crc);
+    }
+
+    /**
+     * @brief Write the records as one frame at the end of the log, and flush it
+     */
+    void write_frame(std::span<const char> payload) {
+        const FrameHeader header{FRAME_MAGIC, next_sequence, payload.size(), checksum(next_sequence, payload)};
+        std::vector<char> frame(sizeof(FrameHeader) + payload.size());
+        memcpy(frame.data(), &header, sizeof(FrameHeader));
+        memcpy(frame.data() + sizeof(FrameHeader), payload.data(), payload.size());
+        if (pwrite(fd, frame.data(), frame.size(), static_cast<off_t>(end)) != static_cast<ssize_t>(frame.size())) {
+            throw std::runtime_error("Unable to write log");
+        }
+        if (fdatasync(fd) != 0) {
+            throw std::runtime_error("Unable to flush log");
+        }
+        end += frame.size();
+        ++next_sequence;
+    }
+
+    void open() {
+        fd = ::open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open log");
+        }
+        struct stat st{};
+        fstat(fd, &st);
+        end = st.st_size;
+    }
+
+public:
+    /**
+     * @brief State of the database file as of the last frame written in full
+     */
+    struct Recovered {
+        std::map<IdT, std::vector<char>> pages;  // last committed image of each page in the log
+        std::vector<std::vector<uint64_t>> redo;  // redo records logged since the scheme last saved its metadata
+    };
+
+    WriteAheadLog(const std::string &file_name, uint32_t pageSize) : file_name(file_name), page_size(pageSize) {
+        open();
+    }
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    ~WriteAheadLog() {
+        close(fd);
+    }
+
+    uint64_t size() const {
+        return end;
+    }
+
+    /**
+     * @brief Add the image of a page to the batch, replacing the one written earlier in the batch
+     */
+    void log_page(IdT page_id, const char* page_data) {
+        auto &image = pages[page_id];
+        image.assign(page_data, page_data + page_size);
+    }
+
+    /**
+     * @brief Get the image of a page written in the batch
+     * @return Pointer to page_size bytes, or nullptr if the page wasn't written since the last commit
+     */
+    const char* find_page(IdT page_id) const {
+        const auto it = pages.find(page_id);
+        return it == pages.end() ? nullptr : it->second.data();
+    }
+
+    void log_redo(std::span<const uint64_t> record) {
+        append(records, REDO, 0, record.data(), record.size_bytes());
+    }
+
+    void log_clear_redo() {
+        append(records, CLEAR_REDO, 0, nullptr, 0);
+    }
+
+    bool has_pending() const {
+        return !pages.empty() || !records.empty();
+    }
+
+    /**
+     * @brief Make the batch durable, with a single flush of the log
+     * The pages of the batch are kept till clear_pending(), so that they can be written to the database file.
+     */
+    void commit() {
+        if (!has_pending()) {
+            return;
+        }
+        std::vector<char> payload;
+        payload.reserve(pages.size() * (sizeof(RecordHeader) + page_size) + records.size());
+        for (const auto &[page_id, image]: pages) {
+            append(payload, PAGE, page_id, image.data(), page_size);
+        }
+        payload.insert(payload.end(), records.begin(), records.end());
+        write_frame(payload);
+        records.clear();
+    }
+
+    const std::map<IdT, std::vector<char>> &pending_pages() const {
+        return pages;
+    }
+
+    void clear_pending() {
+        pages.clear();
+    }
+
+    /**
+     * @brief Read back the frames written in full, stopping at the first torn or corrupt one
+     */
+    Recovered recover() {
+        Recovered recovered;
+        std::vector<char> log(end);
+        if (end && pread(fd, log.data(), end, 0) != static_cast<ssize_t>(end)) {
+            throw std::runtime_error("Bad log read");
+        }
+        uint64_t pos = 0, expected = 0;
+        while (pos + sizeof(FrameHeader) <= end) {
+            FrameHeader header{};
+            memcpy(&header, log.data() + pos, sizeof(FrameHeader));
+            const uint64_t start = pos + sizeof(FrameHeader);
+            if (header.magic != FRAME_MAGIC || header.size > end - start || (expected && header.sequence != expected) ||
+                header.checksum != checksum(header.sequence, {log.data() + start, header.size})) {
+                break;
+            }
+            for (uint64_t at = start; at < start + header.size;) {
+                RecordHeader record{};
+                memcpy(&record, log.data() + at, sizeof(RecordHeader));
+                const char* data = log.data() + at + sizeof(RecordHeader);
+                if (record.kind == PAGE) {
+                    if (record.size != page_size) {
+                        throw std::runtime_error("Page size mismatch");
+                    }
+                    recovered.pages[record.id].assign(data, data + record.size);
+                } else if (record.kind == REDO) {
+                    auto &words = recovered.redo.emplace_back(record.size / sizeof(uint64_t));
+                    memcpy(words.data(), data, record.size);
+                } else {
+                    recovered.redo.clear();
+                }
+                at += sizeof(RecordHeader) + (record.size + 7) / 8 * 8;
+            }
+            pos = start + header.size;
+            expected = header.sequence + 1;
+            next_sequence = expected;
+        }
+        return recovered;
+    }
+
+    /**
+     * @brief Start the log over, holding only the given redo records
+     * This is only safe once the pages of all the frames are durable in the database file. The new log is written
+     * next to the old one and renamed over it, so that the redo records are never lost.
+     */
+    void reset(const std::vector<std::vector<uint64_t>> &redo) {
+        if (has_pending()) {
+            throw std::runtime_error("Can't reset the log with uncommitted changes");
+        }
+        if (!end && redo.empty()) {
+            return;
+        }
+        const std::string temp_name = file_name + ".tmp";
+        const int old_fd = fd;
+        fd = ::open(temp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fd = old_fd;
+            throw std::runtime_error("Unable to open log");
+        }
+        close(old_fd);
+        end = 0;
+        std::vector<char> payload;
+        for (const auto &record: redo) {
+            append(payload, REDO, 0, record.data(), record.size() * sizeof(uint64_t));
+        }
+        if (!payload.empty()) {
+            write_frame(payload);
+        } else if (fdatasync(fd) != 0) {
+            throw std::runtime_error("Unable to flush log");
+        }
+        if (rename(temp_name.c_str(), file_name.c_str()) != 0) {
+            throw std::runtime_error("Unable to replace log");
+        }
+        // the rename itself only becomes durable with the directory
+        auto dir_name = std::filesystem::path(file_name).parent_path();
+        const int dir_fd = ::open(dir_name.empty() ? "." : dir_name.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+};
+
+#endif //WRITEAHEADLOG_HPP
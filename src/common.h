@@ -1,9 +1,16 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <cstddef>
 #include <cstdint>
 
 using IdT = uint64_t;
 const uint32_t PAGE_SIZE = 1 << 10;
+const size_t BUFFER_POOL_FRAMES = 128;  // default number of pages cached in memory
+const size_t MMAP_MAX_SIZE = 1ULL << 36;  // default address space reserved for a memory mapped file
+const size_t DIRECT_IO_ALIGNMENT = 4096;  // alignment of the buffers, offsets and sizes of O_DIRECT I/O
+const uint32_t ASYNC_QUEUE_DEPTH = 32;  // default number of page reads/writes in flight at once
+const uint64_t WAL_CHECKPOINT_SIZE = 1 << 24;  // size of the write-ahead log at which the file is flushed and it restarts
+const uint64_t WAL_MAX_BATCH_PAGES = 4096;  // page write-backs after which the batch of the log is committed
 
 #endif //COMMON_H
@@ -3,28 +3,123 @@
 #include "common.hpp"
 
 TEST_SUITE("Bucket") {
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Read/Write") {
-        Bucket<int, int> b(&dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Read/Write") {
+        Bucket<int, int> b(&bp);
         b.insert(4, 5);
         int v;
         REQUIRE(b.find(4, &v));
         REQUIRE(v == 5);
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Empty") {
-        Bucket<int, int> b(&dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Empty") {
+        Bucket<int, int> b(&bp);
         REQUIRE(b.is_empty());
         b.insert(4, 5);
         REQUIRE(!b.is_empty());
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Full") {
-        Bucket<int, int> b(&dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Full") {
+        Bucket<int, int> b(&bp);
         int i = 0;
         while (!b.is_full()) {
             b.insert(i, i * 2);
             ++i;
         }
-        REQUIRE(i == 126);  // for page_size = 1KB, we can fit 126 (int, int) entries into the page
+        // for page_size = 1KB, we can fit 112 (int, int) entries and their tags into the page
+        REQUIRE(i == 112);
+        REQUIRE(i == Bucket<int, int>::capacity_for(PAGE_SIZE));
+    }
+
+    TEST_CASE("Page sizes") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_page_size.db").string();
+        for (uint32_t page_size: {4096u, 16384u, 65536u}) {
+            std::filesystem::remove(path);
+            DiskManager disk(path, page_size);
+            BufferPool pool(&disk, 4);
+            Bucket<int, int> b(&pool);
+            // the whole page is used, not only the default PAGE_SIZE bytes
+            CHECK(b.capacity == Bucket<int, int>::capacity_for(page_size));
+            CHECK(b.capacity > page_size / 10);
+            int i = 0;
+            while (!b.is_full()) {
+                b.insert(i, i * 2);
+                ++i;
+            }
+            REQUIRE(i == b.capacity);
+            int v;
+            REQUIRE(b.find(i - 1, &v));
+            REQUIRE(v == (i - 1) * 2);
+
+            Bucket<std::string, std::string> sb(&pool);
+            while (!sb.is_full()) {
+                sb.insert(std::to_string(i), std::to_string(i));
+                ++i;
+            }
+            CHECK(sb.read_page().size() > page_size / 32);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Occupancy is cached") {
+        Bucket<int, int> b(&bp);
+        b.insert(4, 5);
+        bp.reset_stats();
+        REQUIRE(!b.is_full());
+        REQUIRE(!b.is_empty());
+        REQUIRE(bp.num_hits + bp.num_misses == 0);
+
+        // a bucket opened from an existing page reads its header only once
+        Bucket<int, int> reopened(&bp, b.page_id);
+        REQUIRE(!reopened.is_empty());
+        REQUIRE(!reopened.is_full());
+        REQUIRE(bp.num_hits + bp.num_misses == 1);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove") {
+        Bucket<int, int> b(&bp);
+        for (int i = 0; i < 10; ++i) {
+            b.insert(i, i * 2);
+        }
+        REQUIRE(b.remove(3));
+        REQUIRE(!b.remove(3));
+        int v;
+        REQUIRE(!b.find(3, &v));
+        // the last entry is moved into the freed slot
+        REQUIRE(b.find(9, &v));
+        REQUIRE(v == 18);
+        REQUIRE(b.read_page().size() == 9);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Non-trivial types") {
+        Bucket<std::string, std::string> b(&bp);
+        REQUIRE(b.insert("key", "value"));
+        REQUIRE(!b.insert("key", "other"));
+        std::string v;
+        REQUIRE(b.find("key", &v));
+        REQUIRE(v == "value");
+        REQUIRE(b.remove("key"));
+        REQUIRE(b.is_empty());
+
+        int i = 0;
+        while (!b.is_full()) {
+            b.insert(std::to_string(i), std::string(20, 'x'));
+            ++i;
+        }
+        REQUIRE(b.read_page().size() == i);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries of growing size") {
+        Bucket<std::string, std::string> b(&bp);
+        int i = 0;
+        for (;; ++i) {
+            const std::string value(1 + 2 * i, 'x');
+            if (b.is_full(std::to_string(i), value)) {
+                break;
+            }
+            REQUIRE(b.insert(std::to_string(i), value));
+        }
+        // the entry which was found not to fit really doesn't
+        CHECK_THROWS_AS(b.insert(std::to_string(i), std::string(1 + 2 * i, 'x')), std::runtime_error);
+        CHECK(b.read_page().size() == i);
     }
 }
@@ -0,0 +1,102 @@
+#include <cstring>
+#include "doctest.h"
+#include "common.hpp"
+#include "BufferPool.hpp"
+#include "AsyncDiskManager.hpp"
+
+TEST_SUITE("BufferPool") {
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Hit/Miss") {
+        BufferPool bp(&dm, 2);
+        const auto page_id = bp.new_page();
+        strcpy(bp.fetch_page(page_id), "Hello");
+        bp.unpin_page(page_id, true);
+        CHECK(bp.num_hits == 1);
+        CHECK(dm.num_writes == 0);
+
+        bp.flush_all();
+        CHECK(dm.num_writes == 1);
+
+        // cached, no read from the disk
+        CHECK(strcmp(bp.fetch_page(page_id), "Hello") == 0);
+        bp.unpin_page(page_id, false);
+        CHECK(bp.num_hits == 2);
+        CHECK(bp.num_misses == 0);
+        CHECK(dm.num_reads == 0);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Eviction") {
+        BufferPool bp(&dm, 2);
+        IdT pages[3];
+        for (int i = 0; i < 3; ++i) {
+            pages[i] = bp.new_page();
+            sprintf(bp.fetch_page(pages[i]), "Page %d", i);
+            bp.unpin_page(pages[i], true);
+        }
+        // first page was the least recently used, so it should have been written back
+        CHECK(bp.num_evictions == 1);
+        CHECK(dm.num_writes == 1);
+
+        char* data = bp.fetch_page(pages[0]);
+        CHECK(strcmp(data, "Page 0") == 0);
+        CHECK(bp.num_misses == 1);
+        bp.unpin_page(pages[0], false);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Pinned pages are not evicted") {
+        BufferPool bp(&dm, 2);
+        const auto first = bp.new_page();
+        const auto second = bp.new_page();
+        bp.fetch_page(first);
+        bp.fetch_page(second);
+        const auto last_used_page = dm.last_used_page;
+        CHECK_THROWS_AS(bp.new_page(), std::runtime_error);
+        // the failed allocation doesn't leak a page of the file
+        CHECK(dm.last_used_page == last_used_page);
+
+        bp.unpin_page(second, false);
+        bp.new_page();
+        // the pinned page must still be cached
+        bp.fetch_page(first);
+        CHECK(bp.num_misses == 0);
+        bp.unpin_page(first, false);
+        bp.unpin_page(first, false);
+    }
+
+    TEST_CASE("Prefetch") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_prefetch.db").string();
+        std::filesystem::remove(path);
+        {
+            AsyncDiskManager adm(path);
+            BufferPool bp(&adm, 8);
+            std::vector<IdT> pages;
+            for (int i = 0; i < 16; ++i) {
+                pages.push_back(bp.new_page());
+                sprintf(bp.fetch_page(pages[i]), "Page %d", i);
+                bp.unpin_page(pages[i], true);
+            }
+            // only the last 8 pages are cached, and the pool can only make room for 8 of these
+            const std::vector<IdT> evicted(pages.begin(), pages.begin() + 9);
+            bp.reset_stats();
+            bp.prefetch(evicted);
+            CHECK(bp.num_prefetches == 8);
+            for (int i = 0; i < 8; ++i) {
+                CHECK(strcmp(bp.fetch_page(pages[i]), ("Page " + std::to_string(i)).c_str()) == 0);
+                bp.unpin_page(pages[i], false);
+            }
+            CHECK(bp.num_misses == 0);
+            // already cached
+            bp.prefetch(std::span<const IdT>(pages).subspan(4, 4));
+            CHECK(bp.num_prefetches == 8);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Prefetch is skipped without overlapping reads") {
+        BufferPool bp(&dm, 2);
+        const IdT pages[] = {bp.new_page(), bp.new_page(), bp.new_page()};
+        bp.reset_stats();
+        bp.prefetch(pages);
+        CHECK(bp.num_prefetches == 0);
+        CHECK(dm.num_reads == 0);
+    }
+}
@@ -4,10 +4,14 @@
 #include <filesystem>
 
 #define private public
+#define protected public
 
 #include "DiskManager.hpp"
 
 #undef private
+#undef protected
+
+#include "BufferPool.hpp"
 
 class DiskManagerFixture {
 private:
@@ -15,6 +19,8 @@ private:
     static std::string get_temp_db_path() {
         auto path = std::filesystem::temp_directory_path();
         path /= "temp.db";
+        // start from an empty file, the DiskManager would reopen whatever is left over from an earlier run
+        std::filesystem::remove(path);
         return path.string();
     }
 
@@ -31,4 +37,11 @@ public:
 
 };
 
+class BufferPoolFixture : public DiskManagerFixture {
+protected:
+    BufferPool bp;
+
+    BufferPoolFixture() : bp(&dm) {}
+};
+
 #endif //COMMON_HPP
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "doctest.h"
+#include "common.hpp"
+#include "ConcurrentExtendibleHashing.hpp"
+#include "MmapDiskManager.hpp"
+#include "Stopwatch.hpp"
+
+/**
+ * @brief Run fn(thread_idx) on each of num_threads threads, and wait for all of them to finish
+ */
+template<typename Fn>
+void run_threads(unsigned num_threads, Fn fn) {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; ++t) {
+        threads.emplace_back(fn, t);
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+TEST_SUITE("ConcurrentExtendibleHashing") {
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Concurrent Insert/Get/Remove") {
+        constexpr unsigned num_threads = 4;
+        constexpr unsigned keys_per_thread = 5000;
+        DiskManager* disk = &dm;
+        std::unique_ptr<MmapDiskManager> mmap_dm;
+        SUBCASE("pread") {}
+        SUBCASE("mmap") {
+            mmap_dm = std::make_unique<MmapDiskManager>(path + ".mmap");
+            disk = mmap_dm.get();
+        }
+        {
+            BufferPool pool(disk, 16);
+            ConcurrentExtendibleHashing<int, int> eh(&pool);
+            std::atomic<int> failures{0};
+            // each thread inserts its own keys, so the buckets are split under contention
+            run_threads(num_threads, [&](unsigned t) {
+                for (unsigned i = 0; i < keys_per_thread; ++i) {
+                    const auto key = static_cast<int>(i * num_threads + t);
+                    failures += !eh.insert(key, key * 2);
+                }
+            });
+            CHECK(failures == 0);
+            for (unsigned i = 0; i < keys_per_thread * num_threads; ++i) {
+                const int key = static_cast<int>(i);
+                int v;
+                REQUIRE(eh.get(key, &v));
+                REQUIRE(v == key * 2);
+            }
+
+            // half the threads remove the odd keys while the other half keep reading the even ones
+            constexpr unsigned num_removers = num_threads / 2;
+            run_threads(num_threads, [&](unsigned t) {
+                for (unsigned i = 0; i < keys_per_thread * num_threads / 2; ++i) {
+                    const int key = static_cast<int>(2 * i);
+                    int v;
+                    if (t % 2 == 0) {
+                        failures += !eh.get(key, &v) || v != 2 * key;
+                    } else if (i % num_removers == t / 2) {
+                        failures += !eh.remove(key + 1);
+                    }
+                }
+            });
+            CHECK(failures == 0);
+            for (unsigned i = 0; i < keys_per_thread * num_threads; ++i) {
+                int v;
+                REQUIRE(eh.get(static_cast<int>(i), &v) == (i % 2 == 0));
+            }
+        }
+        if (mmap_dm) {
+            mmap_dm.reset();
+            std::filesystem::remove(path + ".mmap");
+        }
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Throughput Perf") {
+        constexpr int num_entries = 100000;
+        const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+            SUBCASE((std::to_string(num_threads) + " threads").c_str()) {
+                BufferPool pool(&dm);
+                ConcurrentExtendibleHashing<int, int> eh(&pool);
+                const int per_thread = num_entries / static_cast<int>(num_threads);
+                Stopwatch sw;
+                run_threads(num_threads, [&](unsigned t) {
+                    for (int i = 0; i < per_thread; ++i) {
+                        eh.insert(i * static_cast<int>(num_threads) + static_cast<int>(t), i);
+                    }
+                });
+                const auto insertion_time = sw.stop();
+                sw.start();
+                run_threads(num_threads, [&](unsigned t) {
+                    int v;
+                    for (int i = 0; i < per_thread; ++i) {
+                        eh.get(i * static_cast<int>(num_threads) + static_cast<int>(t), &v);
+                    }
+                });
+                const auto lookup_time = sw.stop();
+                const int total = per_thread * static_cast<int>(num_threads);
+                MESSAGE("Insert Throughput: ", total * 1000000.0 / std::max<uint64_t>(insertion_time, 1), " ops/s");
+                MESSAGE("Lookup Throughput: ", total * 1000000.0 / std::max<uint64_t>(lookup_time, 1), " ops/s");
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#include "doctest.h"
+#include "common.hpp"
+#include "CuckooHashing.hpp"
+
+TEST_SUITE("CuckooHashing") {
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Insert/Get") {
+        CuckooHashing<int, int> ch(4, &bp);
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(ch.insert(i, i * 2));
+        }
+        REQUIRE_FALSE(ch.insert(42, 0));
+        // 4 buckets can't hold all the entries, so the table must have been rehashed
+        CHECK(ch.num_rehashes > 0);
+        CHECK(ch.get_num_buckets() > 4);
+        for (int i = 0; i < 5000; ++i) {
+            int v;
+            REQUIRE(ch.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+        int v;
+        REQUIRE_FALSE(ch.get(5000, &v));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove") {
+        CuckooHashing<int, int> ch(4, &bp);
+        for (int i = 0; i < 1000; ++i) {
+            ch.insert(i, i);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(ch.remove(i));
+        }
+        REQUIRE_FALSE(ch.remove(0));
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(ch.get(i, &v) == (i % 2 == 1));
+        }
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries of growing size") {
+        CuckooHashing<std::string, std::string> ch(2, &bp);
+        CHECK_THROWS_AS(ch.insert("large", std::string(PAGE_SIZE * 2, 'x')), std::runtime_error);
+        // every value is larger than any before it, so kicking out an entry doesn't always make room for the new one
+        for (int i = 0; i < 400; ++i) {
+            REQUIRE(ch.insert(std::to_string(i), std::string(1 + 2 * i, 'x')));
+        }
+        CHECK_THROWS_AS(ch.insert("large", std::string(PAGE_SIZE, 'x')), std::runtime_error);
+        // the failed insert didn't kick out any entry
+        for (int i = 0; i < 400; ++i) {
+            std::string v;
+            REQUIRE(ch.get(std::to_string(i), &v));
+            REQUIRE(v.size() == 1 + 2 * i);
+        }
+        std::string v;
+        CHECK_FALSE(ch.get("large", &v));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Lookups read at most two pages") {
+        // 48 buckets have room for 5376 entries
+        CuckooHashing<int, int> ch(48, &bp);
+        for (int i = 0; i < 5000; ++i) {
+            ch.insert(i, i);
+        }
+        REQUIRE(ch.get_num_buckets() == 48);
+        // a table this full needs to kick out entries to place new ones
+        CHECK(ch.max_kick_chain() > 0);
+        REQUIRE(ch.num_stashed == 0);
+        for (int i = 0; i < 6000; ++i) {
+            bp.reset_stats();
+            int v;
+            ch.get(i, &v);
+            REQUIRE(bp.num_hits + bp.num_misses <= 2);
+        }
+    }
+
+    TEST_CASE("Reopen") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_reopen.db").string();
+        std::filesystem::remove(path);
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            CuckooHashing<int, int> ch(4, &pool);
+            for (int i = 0; i < 3000; ++i) {
+                ch.insert(i, i * 2);
+            }
+            ch.remove(5);
+        }
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            // the stored table and hash functions are used
+            CuckooHashing<int, int> ch(1, &pool);
+            for (int i = 0; i < 3000; ++i) {
+                int v;
+                REQUIRE(ch.get(i, &v) == (i != 5));
+                if (i != 5) {
+                    REQUIRE(v == i * 2);
+                }
+            }
+        }
+        std::filesystem::remove(path);
+    }
+}
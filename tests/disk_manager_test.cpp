@@ -1,21 +1,28 @@
 #include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
 #include "common.hpp"
 #include "doctest.h"
 
 #define private public
+#define protected public
 
 #include "DiskManager.hpp"
+#include "MmapDiskManager.hpp"
+#include "AsyncDiskManager.hpp"
 
 #undef private
+#undef protected
 
 TEST_SUITE("DiskManager") {
     TEST_CASE_FIXTURE(DiskManagerFixture, "Create/open file") {
-        REQUIRE(dm.db_file.is_open());
+        REQUIRE(dm.fd >= 0);
     }
 
     TEST_CASE_FIXTURE(DiskManagerFixture, "Read/write") {
         auto cur_page = dm.new_page();
-        CHECK(cur_page == 0);
+        CHECK(cur_page == 1);  // page 0 holds the superblock
 
         const int page_size = 1 << 16;
 
@@ -28,7 +35,7 @@ TEST_SUITE("DiskManager") {
 
         CHECK(strcmp(read_buf, "Hello") == 0);
         cur_page = dm.new_page();
-        CHECK(cur_page == 1);
+        CHECK(cur_page == 2);
 
         sprintf(data, "World");
 
@@ -40,4 +47,224 @@ TEST_SUITE("DiskManager") {
         delete[] data;
         delete[] read_buf;
     }
+
+    TEST_CASE("Reopen") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_reopen.db").string();
+        std::filesystem::remove(path);
+        char data[PAGE_SIZE] = "Hello";
+        {
+            DiskManager disk(path);
+            for (int i = 0; i < 10; ++i) {
+                disk.write_page(disk.new_page(), data);
+            }
+            disk.set_root_page(3);
+        }
+        {
+            DiskManager disk(path);
+            CHECK(disk.get_root_page() == 3);
+            CHECK(disk.new_page() == 11);
+            char read_buf[PAGE_SIZE];
+            disk.read_page(10, read_buf);
+            CHECK(strcmp(read_buf, "Hello") == 0);
+        }
+        CHECK_THROWS_AS(DiskManager(path, PAGE_SIZE * 2), std::runtime_error);
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Group commit") {
+        char data[PAGE_SIZE] = "Hello";
+        const auto page_id = dm.new_page();
+        SUBCASE("Explicit sync") {
+            for (int i = 0; i < 10; ++i) {
+                dm.write_page(page_id, data);
+            }
+            CHECK(dm.num_flushes == 0);
+            dm.sync();
+            CHECK(dm.num_flushes == 1);
+            // nothing pending
+            dm.sync();
+            CHECK(dm.num_flushes == 1);
+        }
+        SUBCASE("Every N writes") {
+            dm.set_sync_policy({.max_pending_writes = 4});
+            for (int i = 0; i < 10; ++i) {
+                dm.write_page(page_id, data);
+            }
+            CHECK(dm.num_flushes == 2);
+        }
+        SUBCASE("Every T microseconds") {
+            dm.set_sync_policy({.max_delay = std::chrono::microseconds(1)});
+            dm.write_page(page_id, data);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            dm.write_page(page_id, data);
+            CHECK(dm.num_flushes == 1);
+        }
+    }
+
+    TEST_CASE("Memory mapped") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_mmap.db").string();
+        std::filesystem::remove(path);
+        {
+            MmapDiskManager mdm(path);
+            BufferPool bp(&mdm);
+            for (int i = 0; i < 100; ++i) {
+                const auto page_id = bp.new_page();
+                CHECK(page_id == i + 1);
+                sprintf(bp.fetch_page(page_id), "Page %d", i);
+                bp.unpin_page(page_id, true);
+            }
+            // pages are accessed in place, without copying through the DiskManager
+            CHECK(mdm.num_reads == 0);
+            CHECK(mdm.num_writes == 0);
+            CHECK(strcmp(mdm.map_page(43), "Page 42") == 0);
+            mdm.sync();
+        }
+        CHECK(std::filesystem::file_size(path) == 101 * PAGE_SIZE);
+        {
+            MmapDiskManager mdm(path);
+            char read_buf[PAGE_SIZE];
+            mdm.read_page(100, read_buf);
+            CHECK(strcmp(read_buf, "Page 99") == 0);
+            CHECK(mdm.new_page() == 101);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE("Asynchronous I/O") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_async.db").string();
+        std::filesystem::remove(path);
+        bool use_io_uring = true;
+        SUBCASE("io_uring") {}
+        SUBCASE("Thread pool") {
+            use_io_uring = false;
+        }
+        constexpr int num_pages = 64;
+        {
+            // fewer requests in flight than submitted, so some submissions wait for others to finish
+            AsyncDiskManager adm(path, PAGE_SIZE, 4, use_io_uring);
+            if (use_io_uring && !adm.uses_io_uring()) {
+                MESSAGE("io_uring is not available, using the thread pool");
+            }
+            CHECK(adm.overlaps_reads());
+            std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+            std::vector<std::future<void>> writes;
+            for (int i = 0; i < num_pages; ++i) {
+                const auto page_id = adm.new_page();
+                sprintf(pages[i].data(), "Page %d", i);
+                writes.push_back(adm.write_page_async(page_id, pages[i].data()));
+            }
+            for (auto &write: writes) {
+                write.get();
+            }
+            CHECK(adm.num_writes == num_pages);
+
+            std::vector<std::vector<char>> read_bufs(num_pages, std::vector<char>(PAGE_SIZE));
+            std::vector<std::future<void>> reads;
+            for (int i = 0; i < num_pages; ++i) {
+                reads.push_back(adm.read_page_async(i + 1, read_bufs[i].data()));
+            }
+            for (int i = 0; i < num_pages; ++i) {
+                reads[i].get();
+                REQUIRE(strcmp(read_bufs[i].data(), pages[i].data()) == 0);
+            }
+            CHECK(adm.num_reads == num_pages);
+
+            // errors are reported through the future
+            char read_buf[PAGE_SIZE];
+            auto past_end = adm.read_page_async(1000, read_buf);
+            CHECK_THROWS_AS(past_end.get(), std::runtime_error);
+            adm.sync();
+        }
+        {
+            DiskManager disk(path);
+            char read_buf[PAGE_SIZE];
+            disk.read_page(num_pages, read_buf);
+            CHECK(strcmp(read_buf, "Page 63") == 0);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE("Direct I/O") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_direct.db").string();
+        std::filesystem::remove(path);
+        CHECK_THROWS_AS(DiskManager(path, 1024, IoMode::Direct), std::runtime_error);
+        constexpr uint32_t page_size = 4096;
+        {
+            DiskManager disk(path, page_size, IoMode::Direct);
+            BufferPool bp(&disk, 4);
+            for (int i = 0; i < 10; ++i) {
+                const auto page_id = bp.new_page();
+                sprintf(bp.fetch_page(page_id), "Page %d", i);
+                bp.unpin_page(page_id, true);
+            }
+            bp.flush_all();
+            // partial reads and unaligned buffers go through an aligned buffer
+            std::vector<char> read_buf(page_size + 1);
+            disk.read_page(3, read_buf.data() + 1);
+            CHECK(strcmp(read_buf.data() + 1, "Page 2") == 0);
+            char prefix[6];
+            disk.peek_page(4, sizeof(prefix), prefix);
+            CHECK(memcmp(prefix, "Page 3", sizeof(prefix)) == 0);
+            disk.remove_page(5);
+            CHECK(disk.new_page() == 5);
+        }
+        {
+            DiskManager disk(path, page_size);
+            std::vector<char> read_buf(page_size);
+            disk.read_page(10, read_buf.data());
+            CHECK(strcmp(read_buf.data(), "Page 9") == 0);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE("Free list") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_free.db").string();
+        std::filesystem::remove(path);
+        {
+            DiskManager disk(path);
+            for (int i = 0; i < 10; ++i) {
+                disk.new_page();
+            }
+            disk.remove_page(3);
+            disk.remove_page(5);
+            CHECK(disk.get_num_free_pages() == 2);
+            // the most recently freed page is reused first
+            CHECK(disk.new_page() == 5);
+            disk.remove_page(5);
+            disk.remove_page(9);
+            disk.remove_page(8);
+            CHECK(disk.get_num_free_pages() == 4);
+            // the last page is dropped from the file instead
+            disk.remove_page(10);
+            CHECK(disk.get_num_free_pages() == 4);
+        }
+        {
+            // the free pages survive reopening the file
+            DiskManager disk(path);
+            CHECK(disk.get_num_free_pages() == 4);
+            disk.compact();
+            // the free pages at the end of the file are given back
+            CHECK(disk.get_num_free_pages() == 2);
+            CHECK(std::filesystem::file_size(path) == 8 * PAGE_SIZE);
+            // the remaining free pages are reused from the start of the file
+            CHECK(disk.new_page() == 3);
+            CHECK(disk.new_page() == 5);
+            CHECK(disk.new_page() == 8);
+        }
+        {
+            MmapDiskManager mdm(path);
+            for (IdT page_id = 9; page_id <= 20; ++page_id) {
+                CHECK(mdm.new_page() == page_id);
+            }
+            for (IdT page_id = 20; page_id >= 10; --page_id) {
+                mdm.remove_page(page_id);
+            }
+            mdm.compact();
+            CHECK(mdm.get_num_free_pages() == 0);
+            CHECK(mdm.new_page() == 10);
+            strcpy(mdm.map_page(10), "Page 10");
+        }
+        CHECK(std::filesystem::file_size(path) == 11 * PAGE_SIZE);
+        std::filesystem::remove(path);
+    }
 }
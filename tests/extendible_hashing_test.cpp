@@ -1,10 +1,12 @@
 #include "doctest.h"
 #include "common.hpp"
 #include "ExtendibleHashing.hpp"
+#include "StaticHashing.hpp"
+#include "Stopwatch.hpp"
 
 TEST_SUITE("ExtendibleHashing") {
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Insert/Get") {
-        ExtendibleHashing<int, int> eh(&dm, [](const int x) { return x + 1; });
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Insert/Get") {
+        ExtendibleHashing<int, int, HashFunction<int>> eh(&bp, [](const int x) { return x + 1; });
         for (int i = 0; i < 1000; ++i) {
             eh.insert(i, i * 2);
         }
@@ -15,8 +17,8 @@ TEST_SUITE("ExtendibleHashing") {
         }
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Insert/Get2") {
-        ExtendibleHashing<int, int> eh(&dm, [](const int x) { return x; });
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Insert/Get2") {
+        ExtendibleHashing<int, int, HashFunction<int>> eh(&bp, [](const int x) { return x; });
         for (int i = 1000; i >= 0; --i) {
             eh.insert(i, i * 2);
         }
@@ -27,8 +29,8 @@ TEST_SUITE("ExtendibleHashing") {
         }
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Remove") {
-        ExtendibleHashing<int, int> eh(&dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove") {
+        ExtendibleHashing<int, int> eh(&bp);
         eh.insert(4, 6);
         SUBCASE("Remove exists") {
             bool ret = eh.remove(4);
@@ -40,4 +42,287 @@ TEST_SUITE("ExtendibleHashing") {
         }
     }
 
-}
\ No newline at end of file
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Split writes each page once") {
+        ExtendibleHashing<int, int, HashFunction<int>> eh(&bp, [](const int x) { return x; });
+        // fill up the first bucket
+        const int capacity = Bucket<int, int>::capacity_for(PAGE_SIZE);
+        for (int i = 0; i < capacity; ++i) {
+            eh.insert(i, i * 2);
+        }
+        bp.reset_stats();
+        eh.insert(capacity, capacity * 2);
+        // 2 writes for the split bucket and its new sibling, 1 for the inserted entry
+        CHECK(bp.num_writes == 3);
+        for (int i = 0; i <= capacity; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries of growing size") {
+        ExtendibleHashing<std::string, std::string> eh(&bp);
+        // every value is larger than any before it, so the bucket has to be split on the size of the new entry
+        for (int i = 0; i < 400; ++i) {
+            REQUIRE(eh.insert(std::to_string(i), std::string(1 + 2 * i, 'x')));
+        }
+        for (int i = 0; i < 400; ++i) {
+            std::string v;
+            REQUIRE(eh.get(std::to_string(i), &v));
+            REQUIRE(v.size() == 1 + 2 * i);
+        }
+        CHECK_THROWS_AS(eh.insert("large", std::string(PAGE_SIZE, 'x')), std::runtime_error);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove/Merge") {
+        ExtendibleHashing<int, int, HashFunction<int>> eh(&bp, [](const int x) { return x; });
+        for (int i = 0; i < 1000; ++i) {
+            eh.insert(i, i * 2);
+        }
+        // empty out the buckets of all the odd keys, so that they get merged
+        for (int i = 1; i < 1000; i += 2) {
+            REQUIRE(eh.remove(i));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v) == (i % 2 == 0));
+            if (i % 2 == 0) {
+                REQUIRE(v == i * 2);
+            }
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(eh.remove(i));
+        }
+        int v;
+        REQUIRE(!eh.get(0, &v));
+        REQUIRE(eh.insert(0, 1));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Batch operations") {
+        ExtendibleHashing<int, int> eh(&bp);
+        std::vector<int> keys(1000), values(1000);
+        for (int i = 0; i < 1000; ++i) {
+            keys[i] = i;
+            values[i] = i * 2;
+        }
+        REQUIRE(eh.insert(5, 0));
+        CHECK(eh.multi_insert(keys, values) == 999);
+
+        // every bucket is pinned once, however many of the keys it holds
+        bp.reset_stats();
+        keys.push_back(1000);
+        std::vector<int> found_values(keys.size());
+        std::vector<bool> found;
+        CHECK(eh.multi_get(keys, found_values, found) == 1000);
+        CHECK(bp.num_hits + bp.num_misses < 50);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE(found[i]);
+            REQUIRE(found_values[i] == (i == 5 ? 0 : i * 2));
+        }
+        CHECK_FALSE(found[1000]);
+
+        std::vector<int> odd;
+        for (int i = 1; i < 1000; i += 2) {
+            odd.push_back(i);
+        }
+        CHECK(eh.multi_remove(odd) == 500);
+        CHECK(eh.multi_remove(odd) == 0);
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v) == (i % 2 == 0));
+        }
+        CHECK_THROWS(eh.multi_get(keys, std::span<int>(found_values).first(10), found));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Bulk load") {
+        std::vector<std::pair<int, int>> entries;
+        for (int i = 0; i < 5000; ++i) {
+            entries.emplace_back(i, i * 2);
+        }
+        entries.emplace_back(7, 0);  // repeated keys keep their first value
+        ExtendibleHashing<int, int> eh(&bp, entries);
+        // one write per bucket, the directory page is only written when saving
+        CHECK(bp.num_writes == dm.last_used_page - 1);
+        for (int i = 0; i < 5000; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+        // the loaded structure keeps working as usual
+        for (int i = 5000; i < 10000; ++i) {
+            REQUIRE(eh.insert(i, i * 2));
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            REQUIRE(eh.remove(i));
+        }
+        for (int i = 0; i < 10000; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v) == (i % 2 == 1));
+        }
+        CHECK_THROWS(ExtendibleHashing<int, int>(&bp, entries));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries with the same hash") {
+        // the keys from 1000 on all have the same hash, which no split can tell apart
+        const HashFunction<int> hash_fn([](const int x) { return x < 1000 ? x : 1000; });
+        const int capacity = static_cast<int>(Bucket<int, int>::capacity_for(PAGE_SIZE));
+        SUBCASE("Insert") {
+            ExtendibleHashing<int, int, HashFunction<int>> eh(&bp, hash_fn);
+            for (int i = 0; i < 1000 + capacity; ++i) {
+                REQUIRE(eh.insert(i, i));
+            }
+            const auto global_depth = eh.get_global_depth();
+            CHECK_THROWS_AS(eh.insert(1000 + capacity, 0), std::runtime_error);
+            CHECK(eh.get_global_depth() == global_depth);
+            for (int i = 0; i < 1000 + capacity; ++i) {
+                int v;
+                REQUIRE(eh.get(i, &v));
+                REQUIRE(v == i);
+            }
+        }
+        SUBCASE("Bulk load") {
+            std::vector<std::pair<int, int>> entries;
+            for (int i = 0; i < 1000 + 2 * capacity; ++i) {
+                entries.emplace_back(i, i);
+            }
+            // partitioning stops at the bit which separates key 1000 from the rest, instead of growing the directory
+            // to 2^31 entries, and the entries which don't fit are left to the insert, which can't split them either
+            CHECK_THROWS_AS((ExtendibleHashing<int, int, HashFunction<int>>(&bp, entries, hash_fn)), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Reopen") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_reopen.db").string();
+        std::filesystem::remove(path);
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            ExtendibleHashing<int, int> eh(&pool);
+            for (int i = 0; i < 1000; ++i) {
+                eh.insert(i, i * 2);
+            }
+        }
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            ExtendibleHashing<int, int> eh(&pool);
+            // only the directory is read when reopening
+            CHECK(disk.num_reads < 10);
+            for (int i = 0; i < 1000; ++i) {
+                int v;
+                REQUIRE(eh.get(i, &v));
+                REQUIRE(v == i * 2);
+            }
+            for (int i = 1000; i < 2000; ++i) {
+                REQUIRE(eh.insert(i, i * 2));
+            }
+            REQUIRE(eh.remove(0));
+        }
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            ExtendibleHashing<int, int> eh(&pool);
+            int v;
+            REQUIRE(!eh.get(0, &v));
+            REQUIRE(eh.get(1999, &v));
+            REQUIRE(v == 3998);
+            CHECK_THROWS_AS((StaticHashing<int, int>(10, &pool)), std::runtime_error);
+        }
+        std::filesystem::remove(path);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Bulk Load Perf") {
+        constexpr int num_entries = 100000;
+        std::vector<std::pair<int, int>> entries;
+        for (int i = 0; i < num_entries; ++i) {
+            entries.emplace_back(i, i);
+        }
+        Stopwatch sw;
+        SUBCASE("Insert") {
+            ExtendibleHashing<int, int> eh(&bp);
+            for (auto &[key, value]: entries) {
+                eh.insert(key, value);
+            }
+            bp.sync();
+            MESSAGE("Build Time: ", sw.stop(), "us");
+        }
+        SUBCASE("Bulk load") {
+            ExtendibleHashing<int, int> eh(&bp, entries);
+            bp.sync();
+            MESSAGE("Build Time: ", sw.stop(), "us");
+        }
+        MESSAGE("BP Writes: ", bp.num_writes);
+        MESSAGE("Pages Used: ", dm.last_used_page + 1);
+    }
+
+    TEST_CASE("Page Size Perf") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_page_size.db").string();
+        constexpr int num_entries = 100000;
+        for (uint32_t page_size: {1024u, 4096u, 16384u, 65536u}) {
+            SUBCASE((std::to_string(page_size / 1024) + " KiB pages").c_str()) {
+                std::filesystem::remove(path);
+                DiskManager disk(path, page_size);
+                // the same amount of memory for every page size
+                BufferPool pool(&disk, 4 * 1024 * 1024 / page_size);
+                {
+                    ExtendibleHashing<int, int> eh(&pool);
+                    Stopwatch sw;
+                    for (int i = 0; i < num_entries; ++i) {
+                        eh.insert(i, i);
+                    }
+                    MESSAGE("Insertion Time: ", sw.stop(), "us");
+                    int v;
+                    sw.start();
+                    for (int i = 0; i < num_entries; ++i) {
+                        eh.get(i, &v);
+                    }
+                    MESSAGE("Lookup Time: ", sw.stop(), "us");
+                    MESSAGE("Pages Used: ", disk.last_used_page + 1);
+                    MESSAGE("DM Reads: ", disk.num_reads);
+                }
+                std::filesystem::remove(path);
+            }
+        }
+    }
+
+    TEST_CASE("Split Perf") {
+        // splitting a bucket should only touch its own directory entries, irrespective of the directory size
+        const uint64_t capacity = Bucket<uint64_t, uint64_t>::capacity_for(PAGE_SIZE);
+        constexpr int num_splits = 20;
+        const auto path = (std::filesystem::temp_directory_path() / "temp_split.db").string();
+        for (uint32_t depth: {4, 8, 12, 16, 18, 20}) {
+            SUBCASE(("Global depth " + std::to_string(depth + 1)).c_str()) {
+                uint64_t split_ns = 0;
+                for (int run = 0; run < num_splits; ++run) {
+                    // a new file for every run, an existing structure would be reopened
+                    std::filesystem::remove(path);
+                    DiskManager dm(path);
+                    BufferPool bp(&dm);
+                    ExtendibleHashing<uint64_t, uint64_t, HashFunction<uint64_t>> eh(&bp,
+                                                                                     [](const uint64_t x) { return x; });
+                    // keys with `depth` low zero bits only differ from bit `depth` on, so one more than fit in a bucket
+                    // keep splitting it till the directory has depth + 1 bits, leaving an empty sibling at every
+                    // local depth on the way
+                    for (uint64_t i = 0; i <= capacity; ++i) {
+                        eh.insert(i << depth, i);
+                    }
+                    REQUIRE(eh.get_global_depth() == depth + 1);
+                    // fill the sibling of local depth `depth`, which has two directory entries, to its capacity
+                    const uint64_t low_bits = uint64_t{1} << (depth - 1);
+                    for (uint64_t i = 0; i < capacity; ++i) {
+                        eh.insert(low_bits | (i << depth), i);
+                    }
+                    const auto num_buckets = eh.get_num_buckets();
+                    // the next key splits it without doubling the directory
+                    Stopwatch<std::chrono::nanoseconds> sw;
+                    eh.insert(low_bits | (capacity << depth), capacity);
+                    split_ns += sw.stop();
+                    REQUIRE(eh.get_num_buckets() == num_buckets + 1);
+                    REQUIRE(eh.get_global_depth() == depth + 1);
+                }
+                MESSAGE("Split Time: ", split_ns / num_splits, "ns on average over ", num_splits, " splits");
+                std::filesystem::remove(path);
+            }
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "doctest.h"
+#include "common.hpp"
+#include "Hashes.hpp"
+#include "ExtendibleHashing.hpp"
+#include "Stopwatch.hpp"
+
+TEST_SUITE("Hashes") {
+    TEST_CASE("Known values") {
+        CHECK(Hashes::xxh64("", 0, 0) == 0xEF46DB3751D8E999);
+        CHECK(Hashes::xxh64("abc", 3, 0) == 0x44BC2CF5AD770999);
+        CHECK(Hashes::crc32c("123456789", 9) == 0xE3069283);
+        CHECK(Hashes::crc32c("", 0) == 0);
+    }
+
+    TEST_CASE("Keys") {
+        // strings hash by their characters, whatever holds them
+        const std::string key = "a somewhat longer key, which takes a few rounds of every hash";
+        CHECK(WyHash{}(key) == WyHash{}(std::string_view(key)));
+        CHECK(XXHash64{}(key) == Hashes::xxh64(key.data(), key.size(), 0));
+        CHECK(MurmurHash{}(key) != MurmurHash{}(key.substr(1)));
+        // integers hash by their bytes
+        CHECK(XXHash64{}(uint64_t{42}) == XXHash64{}(uint64_t{42}));
+        CHECK(MurmurHash{}(uint64_t{42}) == Hashes::fmix64(42));
+        CHECK(Crc32cHash{}(42) <= UINT32_MAX);
+        // the seed changes every hash
+        CHECK(MurmurHash{1}(42) != MurmurHash{}(42));
+        CHECK(WyHash{1}(42) != WyHash{}(42));
+        CHECK(XXHash64{1}(42) != XXHash64{}(42));
+        CHECK(Crc32cHash{1}(42) != Crc32cHash{}(42));
+    }
+
+    TEST_CASE("Lengths") {
+        // every length takes a different path through wyhash and XXH64, none of them may ignore bytes
+        std::string data(100, 'x');
+        for (size_t len = 1; len <= data.size(); ++len) {
+            const std::string_view key(data.data(), len);
+            std::string changed(key);
+            changed[len / 2] ^= 1;
+            REQUIRE(WyHash{}(key) != WyHash{}(changed));
+            REQUIRE(XXHash64{}(key) != XXHash64{}(changed));
+            REQUIRE(MurmurHash{}(key) != MurmurHash{}(changed));
+            REQUIRE(Crc32cHash{}(key) != Crc32cHash{}(changed));
+        }
+    }
+
+    TEST_CASE("Type-erased hash") {
+        static_assert(std::is_same_v<DefaultHash<int>, MurmurHash>);
+        static_assert(std::is_same_v<DefaultHash<std::string>, MurmurHash>);
+        static_assert(std::is_same_v<DefaultHash<double>, std::hash<double>>);
+        CHECK(HashFunction<int>{}(42) == std::hash<int>{}(42));
+        CHECK(HashFunction<int>(MurmurHash{})(42) == MurmurHash{}(42));
+        const HashFunction<std::string> by_length = [](const std::string &key) { return key.size(); };
+        CHECK(by_length("abc") == 3);
+    }
+
+    /**
+     * @brief Ratio of the fullest slot to the average, when keys are spread over 1024 slots by the low hash bits
+     * The directory of extendible hashing is indexed the same way.
+     */
+    template<typename Hash>
+    double low_bit_skew(const std::vector<int> &keys) {
+        constexpr uint32_t num_slots = 1024;
+        std::vector<uint32_t> slots(num_slots);
+        Hash hash;
+        for (const int key: keys) {
+            ++slots[hash(key) & (num_slots - 1)];
+        }
+        return *std::max_element(slots.begin(), slots.end()) * num_slots / static_cast<double>(keys.size());
+    }
+
+    template<typename Hash>
+    void hash_perf(BufferPool &bp, DiskManager &dm) {
+        constexpr int num_keys = 100000;
+        std::vector<int> sequential(num_keys), strided(num_keys);
+        for (int i = 0; i < num_keys; ++i) {
+            sequential[i] = i;
+            strided[i] = i << 10;
+        }
+        Hash hash;
+        uint64_t sum = 0;
+        Stopwatch<std::chrono::nanoseconds> sw;
+        for (int round = 0; round < 10; ++round) {
+            for (const int key: sequential) {
+                sum += hash(key);
+            }
+        }
+        MESSAGE("Hashing Time: ", static_cast<double>(sw.stop()) / (10.0 * num_keys), "ns/key");
+        MESSAGE("Checksum: ", sum);
+        MESSAGE("Skew (sequential keys): ", low_bit_skew<Hash>(sequential));
+        MESSAGE("Skew (strided keys): ", low_bit_skew<Hash>(strided));
+
+        ExtendibleHashing<int, int, Hash> eh(&bp);
+        sw.start();
+        for (int i = 0; i < 20000; ++i) {
+            eh.insert(strided[i], i);
+        }
+        MESSAGE("Extendible Insertion Time (strided keys): ", sw.stop() / 1000, "us");
+        MESSAGE("Extendible Pages Used (strided keys): ", dm.last_used_page + 1);
+    }
+
+    template<typename Hash>
+    void lookup_perf(BufferPool &bp, Hash hash) {
+        constexpr int num_keys = 20000;
+        ExtendibleHashing<int, int, Hash> eh(&bp, hash);
+        for (int i = 0; i < num_keys; ++i) {
+            eh.insert(i, i);
+        }
+        int v, found = 0;
+        Stopwatch<std::chrono::nanoseconds> sw;
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < num_keys; ++i) {
+                found += eh.get(i, &v);
+            }
+        }
+        MESSAGE("Lookup Time: ", static_cast<double>(sw.stop()) / (10.0 * num_keys), "ns/key");
+        CHECK(found == 10 * num_keys);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Hash Call Perf") {
+        // enough frames to keep every bucket in memory, so that lookups are bound by the CPU
+        BufferPool pool(&dm, 1024);
+        SUBCASE("Inlined") {
+            lookup_perf(pool, MurmurHash{});
+        }
+        SUBCASE("Type-erased") {
+            lookup_perf(pool, HashFunction<int>(MurmurHash{}));
+        }
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Perf") {
+        SUBCASE("std::hash") {
+            hash_perf<std::hash<int>>(bp, dm);
+        }
+        SUBCASE("Murmur") {
+            hash_perf<MurmurHash>(bp, dm);
+        }
+        SUBCASE("wyhash") {
+            hash_perf<WyHash>(bp, dm);
+        }
+        SUBCASE("XXH64") {
+            hash_perf<XXHash64>(bp, dm);
+        }
+        SUBCASE("CRC32C") {
+            hash_perf<Crc32cHash>(bp, dm);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include <sstream>
+#include "doctest.h"
+#include "common.hpp"
+#include "ExtendibleHashing.hpp"
+#include "InstrumentedScheme.hpp"
+#include "LinearHashing.hpp"
+
+TEST_SUITE("Instrumentation") {
+    TEST_CASE("Histogram") {
+        LatencyHistogram h;
+        CHECK(h.percentile(99) == 0);
+        for (uint64_t i = 1; i <= 1000; ++i) {
+            h.record(i);
+        }
+        CHECK(h.count() == 1000);
+        CHECK(h.max() == 1000);
+        CHECK(h.mean() == doctest::Approx(500.5));
+        // percentiles are only as precise as the buckets, within 1/16 of the value
+        for (const double p: {1.0, 50.0, 99.0, 99.9}) {
+            const auto expected = static_cast<double>(p * 10);
+            CHECK(static_cast<double>(h.percentile(p)) >= expected);
+            CHECK(static_cast<double>(h.percentile(p)) <= expected * 17 / 16);
+        }
+        CHECK(h.percentile(100) == 1000);
+        // small values are kept exactly, huge ones still have a bucket
+        h.reset();
+        h.record(3);
+        h.record(UINT64_MAX);
+        CHECK(h.percentile(50) == 3);
+        CHECK(h.percentile(100) == UINT64_MAX);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Scheme operations") {
+        ExtendibleHashing<int, int> eh(&bp);
+        Instrumentation stats;
+        {
+            InstrumentedScheme<int, int> scheme(&eh, &stats);
+            for (int i = 0; i < 1000; ++i) {
+                scheme.insert(i, i);
+            }
+            int v;
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE(scheme.get(i, &v));
+            }
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE(scheme.remove(i));
+            }
+        }
+        CHECK(stats[Op::Insert].count() == 1000);
+        CHECK(stats[Op::Get].count() == 1000);
+        CHECK(stats[Op::Remove].count() == 1000);
+        CHECK(stats[Op::Split].count() >= stats[Op::Merge].count());
+        CHECK(stats[Op::Grow].count() > 0);
+        CHECK(stats[Op::Merge].count() > 0);
+        CHECK(stats[Op::Shrink].count() > 0);
+        // splits happen within inserts, so they can't take longer
+        CHECK(stats[Op::Split].max() <= stats[Op::Insert].max());
+
+        std::ostringstream out;
+        stats.dump(out);
+        CHECK(out.str().find("insert: count=1000") != std::string::npos);
+        CHECK(out.str().find("split: count=") != std::string::npos);
+
+        // nothing is recorded once the wrapper is gone
+        stats.reset();
+        eh.insert(1, 1);
+        CHECK(stats[Op::Insert].count() == 0);
+        CHECK(stats[Op::Split].count() == 0);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Structural changes only") {
+        LinearHashing<int, int> lh(&bp);
+        Instrumentation stats;
+        lh.set_instrumentation(&stats);
+        for (int i = 0; i < 5000; ++i) {
+            lh.insert(i, i);
+        }
+        CHECK(stats[Op::Insert].count() == 0);
+        CHECK(stats[Op::Split].count() > 0);
+    }
+}
@@ -0,0 +1,84 @@
+#include <thread>
+#include <vector>
+#include "doctest.h"
+#include "common.hpp"
+#include "ExtendibleHashing.hpp"
+#include "InstrumentedScheme.hpp"
+
+TEST_SUITE("IoStats") {
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Attribution") {
+        Instrumentation instr;
+        {
+            // few frames, so that every operation has to go to the disk
+            BufferPool pool(&dm, 4);
+            ExtendibleHashing<int, int> eh(&pool);
+            InstrumentedScheme<int, int> scheme(&eh, &instr);
+            dm.reset_stats();
+            for (int i = 0; i < 3000; ++i) {
+                scheme.insert(i, i);
+            }
+            int v;
+            for (int i = 0; i < 3000; ++i) {
+                REQUIRE(scheme.get(i, &v));
+            }
+            for (int i = 0; i < 3000; ++i) {
+                REQUIRE(scheme.remove(i));
+            }
+        }
+        uint64_t reads = 0, writes = 0;
+        for (size_t op = 0; op < Instrumentation::NUM_OPS; ++op) {
+            reads += dm.io_stats[static_cast<Op>(op)].reads;
+            writes += dm.io_stats[static_cast<Op>(op)].writes;
+        }
+        // every page read and write is attributed to exactly one operation
+        CHECK(reads == dm.num_peeks);
+        CHECK(writes == dm.num_writes);
+        CHECK(dm.io_stats[Op::Get].reads > 0);
+        CHECK(dm.io_stats[Op::Get].bytes_read == dm.io_stats[Op::Get].reads * PAGE_SIZE);
+        // splits write out the two halves of the bucket, evictions are paid by the operation needing the frame
+        CHECK(dm.io_stats[Op::Split].writes > 0);
+        CHECK(dm.io_stats[Op::Insert].writes > 0);
+        CHECK(dm.io_stats[Op::Remove].reads > 0);
+        // the directory is saved outside of any operation
+        CHECK(dm.io_stats[Op::Other].writes > 0);
+    }
+
+    TEST_CASE_FIXTURE(DiskManagerFixture, "Hot pages") {
+        std::vector<char> data(PAGE_SIZE);
+        const IdT cold = dm.new_page(), hot = dm.new_page();
+        dm.write_page(cold, data.data());
+        dm.write_page(hot, data.data());
+        // pages are only counted once tracking is enabled
+        CHECK(dm.io_stats.hottest_pages(10).empty());
+        dm.io_stats.set_page_tracking(true);
+        dm.write_page(cold, data.data());
+        constexpr unsigned num_threads = 4;
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&] {
+                std::vector<char> buf(PAGE_SIZE);
+                for (int i = 0; i < 100; ++i) {
+                    dm.read_page(hot, buf.data());
+                }
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        const auto pages = dm.io_stats.hottest_pages(10);
+        REQUIRE(pages.size() == 2);
+        CHECK(pages[0].page_id == hot);
+        CHECK(pages[0].reads == 100 * num_threads);
+        CHECK(pages[1].page_id == cold);
+        CHECK(pages[1].writes == 1);
+        CHECK(dm.io_stats[Op::Other].reads == 100 * num_threads);
+
+        const auto json = dm.io_stats.to_json(1);
+        CHECK(json.find(R"("reads": 400, "writes": 3)") == 1);
+        CHECK(json.find(R"("other": {"reads": 400)") != std::string::npos);
+        CHECK(json.find(R"("hot_pages": [{"page_id": )" + std::to_string(hot)) != std::string::npos);
+        dm.reset_stats();
+        CHECK(dm.io_stats.to_json() ==
+              R"({"reads": 0, "writes": 0, "bytes_read": 0, "bytes_written": 0, "operations": {}, "hot_pages": []})");
+    }
+}
@@ -0,0 +1,110 @@
+#include "doctest.h"
+#include "common.hpp"
+#include "LinearHashing.hpp"
+
+TEST_SUITE("LinearHashing") {
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Insert/Get") {
+        LinearHashing<int, int> lh(&bp);
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(lh.insert(i, i * 2));
+        }
+        REQUIRE_FALSE(lh.insert(42, 0));
+        for (int i = 0; i < 5000; ++i) {
+            int v;
+            REQUIRE(lh.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+        int v;
+        REQUIRE_FALSE(lh.get(5000, &v));
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove") {
+        LinearHashing<int, int> lh(&bp);
+        lh.insert(4, 6);
+        SUBCASE("Remove exists") {
+            REQUIRE(lh.remove(4));
+            int v;
+            REQUIRE_FALSE(lh.get(4, &v));
+        }
+        SUBCASE("Remove missing key") {
+            REQUIRE_FALSE(lh.remove(2));
+        }
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Grows one slot at a time") {
+        LinearHashing<int, int, std::hash<int>> lh(&bp, std::hash<int>{}, 0.5);
+        uint64_t num_slots = lh.get_num_slots();
+        for (int i = 0; i < 10000; ++i) {
+            lh.insert(i, i);
+            // each insert splits at most one slot
+            REQUIRE(lh.get_num_slots() - num_slots <= 1);
+            num_slots = lh.get_num_slots();
+        }
+        // the load factor is kept just under the limit
+        CHECK(num_slots == 10000 / (Bucket<int, int>::capacity_for(PAGE_SIZE) / 2) + 1);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries larger than a page") {
+        LinearHashing<std::string, std::string> lh(&bp);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(lh.insert(std::to_string(i), std::string(100, 'x')));
+        }
+        const auto last_used_page = dm.last_used_page;
+        CHECK_THROWS_AS(lh.insert("large", std::string(PAGE_SIZE, 'x')), std::runtime_error);
+        // no overflow bucket was chained for it
+        CHECK(dm.last_used_page == last_used_page);
+        for (int i = 0; i < 100; ++i) {
+            std::string v;
+            REQUIRE(lh.get(std::to_string(i), &v));
+        }
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Overflow chains") {
+        // every key lands in the same slot, so it has to overflow into more buckets
+        LinearHashing<int, int, HashFunction<int>> lh(&bp, [](const int) { return 0; });
+        for (int i = 0; i < 1000; ++i) {
+            lh.insert(i, i * 2);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(lh.remove(i));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(lh.get(i, &v) == (i % 2 == 1));
+        }
+    }
+
+    TEST_CASE("Reopen") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_reopen.db").string();
+        std::filesystem::remove(path);
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            LinearHashing<int, int> lh(&pool);
+            for (int i = 0; i < 3000; ++i) {
+                lh.insert(i, i * 2);
+            }
+            lh.remove(5);
+        }
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            LinearHashing<int, int> lh(&pool);
+            for (int i = 0; i < 3000; ++i) {
+                int v;
+                REQUIRE(lh.get(i, &v) == (i != 5));
+                if (i != 5) {
+                    REQUIRE(v == i * 2);
+                }
+            }
+            // keeps splitting from where it left off
+            for (int i = 3000; i < 6000; ++i) {
+                lh.insert(i, i * 2);
+            }
+            int v;
+            REQUIRE(lh.get(5999, &v));
+            REQUIRE(v == 11998);
+        }
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,160 @@
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "doctest.h"
+#include "common.hpp"
+#include "ExtendibleHashing.hpp"
+#include "ShardedScheme.hpp"
+#include "StaticHashing.hpp"
+#include "Stopwatch.hpp"
+
+/**
+ * @brief Fresh files for the shards, removed again when going out of scope
+ */
+struct ShardFiles {
+    std::vector<std::string> paths;
+
+    explicit ShardFiles(size_t num_shards) {
+        for (size_t i = 0; i < num_shards; ++i) {
+            paths.push_back((std::filesystem::temp_directory_path() / ("temp_shard" + std::to_string(i) + ".db"))
+                                    .string());
+            std::filesystem::remove(paths.back());
+        }
+    }
+
+    ~ShardFiles() {
+        for (const auto &path: paths) {
+            std::filesystem::remove(path);
+        }
+    }
+};
+
+TEST_SUITE("ShardedScheme") {
+    TEST_CASE("Insert/Get/Remove") {
+        ShardFiles files(4);
+        ShardedScheme<int, int, ExtendibleHashing<int, int>> sharded(files.paths);
+        REQUIRE(sharded.num_shards() == 4);
+        for (int i = 0; i < 5000; ++i) {
+            REQUIRE(sharded.insert(i, i * 2));
+        }
+        CHECK_FALSE(sharded.insert(7, 0));
+        for (int i = 0; i < 5000; ++i) {
+            int v;
+            REQUIRE(sharded.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+        // the keys are spread over every file
+        for (size_t s = 0; s < sharded.num_shards(); ++s) {
+            CHECK(sharded.get_disk_manager(s)->last_used_page > 5);
+        }
+        for (int i = 0; i < 5000; i += 2) {
+            REQUIRE(sharded.remove(i));
+        }
+        for (int i = 0; i < 5000; ++i) {
+            int v;
+            REQUIRE(sharded.get(i, &v) == (i % 2 == 1));
+        }
+    }
+
+    TEST_CASE("Batch operations") {
+        ShardFiles files(3);
+        bool threads = false;
+        SUBCASE("Calling thread") {}
+        SUBCASE("Shard threads") {
+            threads = true;
+        }
+        // the shards can use a scheme which needs more than a buffer pool
+        ShardedScheme<int, int, StaticHashing<int, int>> sharded(files.paths, [](BufferPool* bp) {
+            return std::make_unique<StaticHashing<int, int>>(16, bp);
+        }, threads);
+        std::vector<int> keys, values;
+        for (int i = 0; i < 3000; ++i) {
+            keys.push_back(i);
+            values.push_back(i * 3);
+        }
+        CHECK(sharded.multi_insert(keys, values) == 3000);
+        CHECK(sharded.multi_insert(keys, values) == 0);
+        keys.push_back(-1);
+        std::vector<int> found_values(keys.size());
+        std::vector<bool> found;
+        CHECK(sharded.multi_get(keys, found_values, found) == 3000);
+        for (int i = 0; i < 3000; ++i) {
+            REQUIRE(found[i]);
+            REQUIRE(found_values[i] == i * 3);
+        }
+        CHECK_FALSE(found[3000]);
+        CHECK(sharded.multi_remove(std::span<const int>(keys).first(1000)) == 1000);
+        CHECK(sharded.multi_get(keys, found_values, found) == 2000);
+        CHECK_THROWS(sharded.multi_get(keys, std::span<int>(found_values).first(10), found));
+    }
+
+    TEST_CASE("Reopen") {
+        ShardFiles files(2);
+        {
+            ShardedScheme<int, int, ExtendibleHashing<int, int>> sharded(files.paths);
+            for (int i = 0; i < 2000; ++i) {
+                sharded.insert(i, i);
+            }
+        }
+        ShardedScheme<int, int, ExtendibleHashing<int, int>> sharded(files.paths);
+        for (int i = 0; i < 2000; ++i) {
+            int v;
+            REQUIRE(sharded.get(i, &v));
+            REQUIRE(v == i);
+        }
+    }
+
+    TEST_CASE("Concurrent clients") {
+        ShardFiles files(4);
+        ShardedScheme<int, int, ExtendibleHashing<int, int>> sharded(files.paths, nullptr, true, PAGE_SIZE, 16);
+        constexpr int num_threads = 4, keys_per_thread = 2000;
+        std::vector<std::thread> threads;
+        std::atomic<int> failures{0};
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < keys_per_thread; ++i) {
+                    const int key = i * num_threads + t;
+                    failures += !sharded.insert(key, key);
+                    int v;
+                    failures += !sharded.get(key, &v) || v != key;
+                }
+                // batches from several clients at once go through the same shard threads
+                std::vector<int> keys(keys_per_thread), values(keys_per_thread);
+                for (int i = 0; i < keys_per_thread; ++i) {
+                    keys[i] = i * num_threads + t;
+                }
+                std::vector<bool> found;
+                failures += sharded.multi_get(keys, values, found) != keys_per_thread;
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        CHECK(failures == 0);
+    }
+
+    TEST_CASE("Sharding Perf") {
+        constexpr int num_keys = 100000;
+        std::vector<int> keys(num_keys), values(num_keys);
+        for (int i = 0; i < num_keys; ++i) {
+            keys[i] = values[i] = i;
+        }
+        for (size_t num_shards: {1, 2, 4, 8}) {
+            SUBCASE((std::to_string(num_shards) + " shards").c_str()) {
+                ShardFiles files(num_shards);
+                // the same amount of memory however many shards there are
+                ShardedScheme<int, int, ExtendibleHashing<int, int>> sharded(
+                        files.paths, nullptr, true, PAGE_SIZE, BUFFER_POOL_FRAMES / num_shards);
+                Stopwatch sw;
+                sharded.multi_insert(keys, values);
+                sharded.sync();
+                MESSAGE("Batch Insertion Time: ", sw.stop(), "us");
+                std::vector<bool> found;
+                sw.start();
+                sharded.multi_get(keys, values, found);
+                MESSAGE("Batch Lookup Time: ", sw.stop(), "us");
+            }
+        }
+    }
+}
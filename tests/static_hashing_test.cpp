@@ -3,17 +3,22 @@
 #include "NaiveScheme.hpp"
 #include "StaticHashing.hpp"
 #include "ExtendibleHashing.hpp"
+#include "LinearHashing.hpp"
+#include "CuckooHashing.hpp"
+#include "SwissTable.hpp"
+#include "MmapDiskManager.hpp"
+#include "AsyncDiskManager.hpp"
 #include "Stopwatch.hpp"
 
 TEST_SUITE("StaticHashing") {
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Insert") {
-        StaticHashing<int, int> static_hash(10, &dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Insert") {
+        StaticHashing<int, int> static_hash(10, &bp);
         bool ret = static_hash.insert(4, 2);
         REQUIRE(ret == true);
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Get") {
-        StaticHashing<int, int> static_hash(10, &dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Get") {
+        StaticHashing<int, int> static_hash(10, &bp);
         static_hash.insert(4, 2);
         int v;
         SUBCASE("Get exists") {
@@ -29,8 +34,8 @@ TEST_SUITE("StaticHashing") {
         }
     }
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Remove") {
-        StaticHashing<int, int> static_hash(10, &dm);
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Remove") {
+        StaticHashing<int, int> static_hash(10, &bp);
         static_hash.insert(4, 2);
         SUBCASE("Remove exists") {
             bool ret = static_hash.remove(4);
@@ -42,6 +47,88 @@ TEST_SUITE("StaticHashing") {
         }
     }
 
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Entries of growing size") {
+        StaticHashing<std::string, std::string> static_hash(4, &bp);
+        std::vector<std::string> keys, values;
+        for (int i = 0; i < 400; ++i) {
+            if (i % 2) {
+                REQUIRE(static_hash.insert(std::to_string(i), std::string(1 + 2 * i, 'x')));
+            } else {
+                keys.push_back(std::to_string(i));
+                values.push_back(std::string(1 + 2 * i, 'x'));
+            }
+        }
+        CHECK(static_hash.multi_insert(keys, values) == 200);
+        for (int i = 0; i < 400; ++i) {
+            std::string v;
+            REQUIRE(static_hash.get(std::to_string(i), &v));
+            REQUIRE(v.size() == 1 + 2 * i);
+        }
+        // no bucket is chained for an entry that doesn't fit in a page
+        const auto last_used_page = dm.last_used_page;
+        CHECK_THROWS_AS(static_hash.insert("large", std::string(PAGE_SIZE, 'x')), std::runtime_error);
+        keys = {"large"};
+        values = {std::string(PAGE_SIZE, 'x')};
+        CHECK_THROWS_AS(static_hash.multi_insert(keys, values), std::runtime_error);
+        CHECK(dm.last_used_page == last_used_page);
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Batch operations") {
+        StaticHashing<int, int> static_hash(4, &bp);
+        std::vector<int> keys, values;
+        for (int i = 0; i < 1000; ++i) {
+            keys.push_back(i);
+            values.push_back(i * 2);
+        }
+        // repeated keys of the batch are only inserted once
+        keys.push_back(7);
+        values.push_back(0);
+        CHECK(static_hash.multi_insert(keys, values) == 1000);
+        CHECK(static_hash.multi_insert(keys, values) == 0);
+
+        std::vector<int> found_values(keys.size());
+        std::vector<bool> found;
+        CHECK(static_hash.multi_get(keys, found_values, found) == keys.size());
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE(found_values[i] == i * 2);
+        }
+
+        keys.resize(500);
+        CHECK(static_hash.multi_remove(keys) == 500);
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(static_hash.get(i, &v) == (i >= 500));
+        }
+    }
+
+    TEST_CASE("Reopen") {
+        const auto path = (std::filesystem::temp_directory_path() / "temp_reopen.db").string();
+        std::filesystem::remove(path);
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            StaticHashing<int, int> static_hash(10, &pool);
+            for (int i = 0; i < 1000; ++i) {
+                static_hash.insert(i, i * 2);
+            }
+            static_hash.remove(5);
+        }
+        {
+            DiskManager disk(path);
+            BufferPool pool(&disk);
+            // the stored number of slots is used
+            StaticHashing<int, int> static_hash(20, &pool);
+            for (int i = 0; i < 1000; ++i) {
+                int v;
+                REQUIRE(static_hash.get(i, &v) == (i != 5));
+                if (i != 5) {
+                    REQUIRE(v == i * 2);
+                }
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
     constexpr int num_entries = 5000;
     constexpr int num_lookups = 10000;
 
@@ -55,45 +142,119 @@ TEST_SUITE("StaticHashing") {
 
     std::array<int, num_lookups> lookups = gen_lookups();
 
-    TEST_CASE_FIXTURE(DiskManagerFixture, "Perf") {
+    double hit_rate(const BufferPool &bp) {
+        const auto accesses = bp.num_hits + bp.num_misses;
+        return accesses ? 100.0 * static_cast<double>(bp.num_hits) / static_cast<double>(accesses) : 0;
+    }
+
+    TEST_CASE_FIXTURE(BufferPoolFixture, "Perf") {
         HashingScheme<int, int>* scheme;  // base class, will be assigned to from each subcase
+        DiskManager* disk = &dm;  // storage backend used by the scheme
+        BufferPool* pool = &bp;
+        std::unique_ptr<MmapDiskManager> mmap_dm;
+        std::unique_ptr<BufferPool> mmap_bp;
+        std::unique_ptr<AsyncDiskManager> async_dm;
+        std::unique_ptr<BufferPool> async_bp;
+        std::unique_ptr<DiskManager> direct_dm;
+        std::unique_ptr<BufferPool> direct_bp;
         if constexpr(num_lookups <= 10000) {  // don't test naive for cases with lots of lookups
             SUBCASE("Naive") {
-                scheme = new NaiveScheme<int, int>(&dm);
+                scheme = new NaiveScheme<int, int>(&bp);
             }
         }
         SUBCASE("Static") {
             for (uint64_t num_slots: {5, 10, 20, 50, 100, 200, 500, 1000}) {
                 SUBCASE((std::to_string(num_slots) + " slots").c_str()) {
-                    scheme = new StaticHashing<int, int>{num_slots, &dm};
+                    scheme = new StaticHashing<int, int>{num_slots, &bp};
                 }
             }
         }
         SUBCASE("Extendible") {
-            scheme = new ExtendibleHashing<int, int>{&dm};
+            scheme = new ExtendibleHashing<int, int>{&bp};
+        }
+        SUBCASE("Linear") {
+            scheme = new LinearHashing<int, int>{&bp};
+        }
+        SUBCASE("Cuckoo") {
+            scheme = new CuckooHashing<int, int>{64, &bp};
         }
-        dm.reset_stats();
+        SUBCASE("Swiss (in-memory)") {
+            scheme = new SwissTable<int, int>{};
+        }
+        SUBCASE("Static 5 slots (async)") {
+            async_dm = std::make_unique<AsyncDiskManager>(path + ".async");
+            async_bp = std::make_unique<BufferPool>(async_dm.get());
+            disk = async_dm.get();
+            pool = async_bp.get();
+            scheme = new StaticHashing<int, int>{5, pool};
+        }
+        SUBCASE("Extendible (direct I/O with 4 KiB pages)") {
+            direct_dm = std::make_unique<DiskManager>(path + ".direct", 4096, IoMode::Direct);
+            direct_bp = std::make_unique<BufferPool>(direct_dm.get());
+            disk = direct_dm.get();
+            pool = direct_bp.get();
+            scheme = new ExtendibleHashing<int, int>{pool};
+        }
+        SUBCASE("Extendible (mmap)") {
+            mmap_dm = std::make_unique<MmapDiskManager>(path + ".mmap");
+            mmap_bp = std::make_unique<BufferPool>(mmap_dm.get());
+            disk = mmap_dm.get();
+            pool = mmap_bp.get();
+            scheme = new ExtendibleHashing<int, int>{pool};
+        }
+        disk->reset_stats();
+        pool->reset_stats();
         Stopwatch sw;
         for (int i = 0; i < num_entries; ++i) {
             scheme->insert(i, i);
         }
+        pool->sync();
         auto insertion_time = sw.stop();
         MESSAGE("Insertion Time: ", insertion_time, "us");
-        MESSAGE("Pages Used: ", dm.last_used_page + 1);
-        MESSAGE("DM Insertion Reads: ", dm.num_reads);
-        MESSAGE("DM Insertion Peeks: ", dm.num_peeks);
-        MESSAGE("DM Insertion Writes: ", dm.num_writes);
-        MESSAGE("DM Insertion Page Accesses: ", dm.num_reads + dm.num_writes);
-        dm.reset_stats();
+        MESSAGE("Pages Used: ", disk->last_used_page + 1);
+        MESSAGE("DM Insertion Reads: ", disk->num_reads);
+        MESSAGE("DM Insertion Peeks: ", disk->num_peeks);
+        MESSAGE("DM Insertion Writes: ", disk->num_writes);
+        MESSAGE("DM Insertion Flushes: ", disk->num_flushes);
+        MESSAGE("DM Insertion Page Accesses: ", disk->num_reads + disk->num_writes);
+        MESSAGE("BP Insertion Hits: ", pool->num_hits);
+        MESSAGE("BP Insertion Misses: ", pool->num_misses);
+        MESSAGE("BP Insertion Hit Rate: ", hit_rate(*pool), "%");
+        disk->reset_stats();
+        pool->reset_stats();
         int v;
+        sw.start();
         for (int &lookup : lookups) {
             scheme->get(lookup, &v);
         }
         auto lookup_time = sw.stop();
         MESSAGE("Lookup Time: ", lookup_time, "us");
-        MESSAGE("DM Lookup Reads: ", dm.num_reads);
-        MESSAGE("DM Lookup Peeks: ", dm.num_peeks);
-        MESSAGE("DM Lookup Page Accesses: ", dm.num_reads);
+        MESSAGE("DM Lookup Reads: ", disk->num_reads);
+        MESSAGE("DM Lookup Peeks: ", disk->num_peeks);
+        MESSAGE("DM Lookup Page Accesses: ", disk->num_reads);
+        MESSAGE("BP Lookup Hits: ", pool->num_hits);
+        MESSAGE("BP Lookup Misses: ", pool->num_misses);
+        MESSAGE("BP Lookup Hit Rate: ", hit_rate(*pool), "%");
+        std::vector<int> batch_values(lookups.size());
+        std::vector<bool> found;
+        sw.start();
+        scheme->multi_get(lookups, batch_values, found);
+        MESSAGE("Batch Lookup Time: ", sw.stop(), "us");
         delete scheme;
+        if (mmap_dm) {
+            mmap_bp.reset();
+            mmap_dm.reset();
+            std::filesystem::remove(path + ".mmap");
+        }
+        if (async_dm) {
+            async_bp.reset();
+            async_dm.reset();
+            std::filesystem::remove(path + ".async");
+        }
+        if (direct_dm) {
+            direct_bp.reset();
+            direct_dm.reset();
+            std::filesystem::remove(path + ".direct");
+        }
     }
 }
\ No newline at end of file
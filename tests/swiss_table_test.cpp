@@ -0,0 +1,140 @@
+#include <unordered_map>
+#include "doctest.h"
+#include "SwissTable.hpp"
+#include "Stopwatch.hpp"
+
+TEST_SUITE("SwissTable") {
+    TEST_CASE("Insert/Get") {
+        SwissTable<int, int> table;
+        for (int i = 0; i < 10000; ++i) {
+            REQUIRE(table.insert(i, i * 2));
+        }
+        REQUIRE_FALSE(table.insert(42, 0));
+        CHECK(table.size() == 10000);
+        for (int i = 0; i < 10000; ++i) {
+            int v;
+            REQUIRE(table.get(i, &v));
+            REQUIRE(v == i * 2);
+        }
+        int v;
+        REQUIRE_FALSE(table.get(10000, &v));
+    }
+
+    TEST_CASE("Remove") {
+        SwissTable<int, int> table;
+        for (int i = 0; i < 1000; ++i) {
+            table.insert(i, i);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(table.remove(i));
+        }
+        REQUIRE_FALSE(table.remove(0));
+        CHECK(table.size() == 500);
+        for (int i = 0; i < 1000; ++i) {
+            int v;
+            REQUIRE(table.get(i, &v) == (i % 2 == 1));
+        }
+    }
+
+    TEST_CASE("Deleted slots are reused") {
+        // a table which never holds more than 100 entries, but sees many different keys
+        SwissTable<int, int, std::hash<int>> table(std::hash<int>{}, 100);
+        for (int i = 0; i < 100000; ++i) {
+            REQUIRE(table.insert(i, i));
+            if (i >= 100) {
+                REQUIRE(table.remove(i - 100));
+            }
+        }
+        for (int i = 99900; i < 100000; ++i) {
+            int v;
+            REQUIRE(table.get(i, &v));
+            REQUIRE(v == i);
+        }
+    }
+
+    TEST_CASE("Non-trivial types") {
+        SwissTable<std::string, std::string> table;
+        for (int i = 0; i < 1000; ++i) {
+            table.insert(std::to_string(i), "value " + std::to_string(i));
+        }
+        std::string v;
+        REQUIRE(table.get("123", &v));
+        REQUIRE(v == "value 123");
+        REQUIRE(table.remove("123"));
+        REQUIRE_FALSE(table.get("123", &v));
+    }
+
+    /**
+     * @brief Spread out the keys, so that an identity std::hash doesn't get the same locality as sequential keys
+     */
+    int scramble(int i) {
+        return static_cast<int>(static_cast<uint32_t>(i) * 2654435761u);
+    }
+
+    TEST_CASE("Perf") {
+        constexpr int num_entries = 200000;
+        SUBCASE("SwissTable") {
+            SwissTable<int, int> table;
+            Stopwatch sw;
+            for (int i = 0; i < num_entries; ++i) {
+                table.insert(scramble(i), i);
+            }
+            MESSAGE("Insertion Time: ", sw.stop(), "us");
+            int v;
+            int64_t sum = 0;
+            sw.start();
+            for (int i = 0; i < num_entries; ++i) {
+                table.get(scramble(i), &v);
+                sum += v;
+            }
+            MESSAGE("Lookup Time: ", sw.stop(), "us");
+            CHECK(sum == int64_t{num_entries} * (num_entries - 1) / 2);
+        }
+        SUBCASE("std::unordered_map") {
+            std::unordered_map<int, int> table;
+            Stopwatch sw;
+            for (int i = 0; i < num_entries; ++i) {
+                table.emplace(scramble(i), i);
+            }
+            MESSAGE("Insertion Time: ", sw.stop(), "us");
+            int64_t sum = 0;
+            sw.start();
+            for (int i = 0; i < num_entries; ++i) {
+                auto it = table.find(scramble(i));
+                if (it != table.end()) {
+                    sum += it->second;
+                }
+            }
+            MESSAGE("Lookup Time: ", sw.stop(), "us");
+            CHECK(sum == int64_t{num_entries} * (num_entries - 1) / 2);
+        }
+    }
+
+    template<typename Hash>
+    void lookup_perf(Hash hash) {
+        constexpr int num_keys = 200000;
+        SwissTable<int, int, Hash> table(hash, num_keys);
+        for (int i = 0; i < num_keys; ++i) {
+            table.insert(scramble(i), i);
+        }
+        int v, found = 0;
+        Stopwatch<std::chrono::nanoseconds> sw;
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < num_keys; ++i) {
+                found += table.get(scramble(i), &v);
+            }
+        }
+        MESSAGE("Lookup Time: ", static_cast<double>(sw.stop()) / (10.0 * num_keys), "ns/key");
+        CHECK(found == 10 * num_keys);
+    }
+
+    TEST_CASE("Hash Call Perf") {
+        // the same hash, called directly or through a std::function
+        SUBCASE("Inlined") {
+            lookup_perf(MurmurHash{});
+        }
+        SUBCASE("Type-erased") {
+            lookup_perf(HashFunction<int>(MurmurHash{}));
+        }
+    }
+}
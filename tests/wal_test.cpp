@@ -0,0 +1,252 @@
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include "doctest.h"
+#include "common.hpp"
+#include "CuckooHashing.hpp"
+#include "ExtendibleHashing.hpp"
+#include "LinearHashing.hpp"
+#include "StaticHashing.hpp"
+#include "Stopwatch.hpp"
+
+/**
+ * @brief A database file with its log, and copies of both standing for what is on the disk after a crash
+ */
+struct CrashFiles {
+    const std::string path = (std::filesystem::temp_directory_path() / "temp_wal.db").string();
+    const std::string crashed = (std::filesystem::temp_directory_path() / "temp_crashed.db").string();
+
+    CrashFiles() {
+        remove_all();
+    }
+
+    ~CrashFiles() {
+        remove_all();
+    }
+
+    void remove_all() const {
+        for (const auto &file: {path, path + ".wal", crashed, crashed + ".wal"}) {
+            std::filesystem::remove(file);
+        }
+    }
+
+    /**
+     * @brief Keep the file as it is now, the pages written to it later are lost in the crash
+     */
+    void keep_file() const {
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    void keep_log() const {
+        std::filesystem::copy_file(path + ".wal", crashed + ".wal",
+                                   std::filesystem::copy_options::overwrite_existing);
+    }
+};
+
+TEST_SUITE("WriteAheadLog") {
+    TEST_CASE("Recover splits and merges") {
+        CrashFiles files;
+        {
+            DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, true);
+            // few frames, so that pages are written back in the middle of the batches
+            BufferPool pool(&dm, 8);
+            ExtendibleHashing<int, int> eh(&pool);
+            for (int i = 0; i < 200; ++i) {
+                eh.insert(i, i);
+            }
+            pool.sync();
+            files.keep_file();
+            for (int i = 200; i < 3000; ++i) {
+                eh.insert(i, i);
+            }
+            for (int i = 0; i < 3000; i += 3) {
+                eh.remove(i);
+            }
+            pool.sync();
+            // crash right after the commit, before its pages made it to the file
+            files.keep_log();
+            // nothing reaches the file before it is committed
+            const auto file_size = std::filesystem::file_size(files.path);
+            for (int i = 3000; i < 4000; ++i) {
+                eh.insert(i, i);
+            }
+            CHECK(std::filesystem::file_size(files.path) == file_size);
+        }
+        bool torn = false;
+        SUBCASE("Complete commit") {}
+        SUBCASE("Torn commit") {
+            // the last frame is ignored, leaving the first commit
+            const auto log = files.crashed + ".wal";
+            std::filesystem::resize_file(log, std::filesystem::file_size(log) - 10);
+            torn = true;
+        }
+        {
+            DiskManager dm(files.crashed, PAGE_SIZE, IoMode::Buffered, true);
+            BufferPool pool(&dm, 8);
+            // the directory was only saved when the structure was created, the splits and merges are redone
+            ExtendibleHashing<int, int> eh(&pool);
+            for (int i = 0; i < 4000; ++i) {
+                int v;
+                REQUIRE(eh.get(i, &v) == (torn ? i < 200 : i < 3000 && i % 3 != 0));
+            }
+            // the recovered structure keeps working, and is saved when closing
+            for (int i = 0; i < 4000; ++i) {
+                eh.insert(i, -i);
+            }
+        }
+        DiskManager dm(files.crashed, PAGE_SIZE, IoMode::Buffered, true);
+        CHECK(dm.redo_records.empty());
+        BufferPool pool(&dm);
+        ExtendibleHashing<int, int> eh(&pool);
+        for (int i = 0; i < 4000; ++i) {
+            int v;
+            REQUIRE(eh.get(i, &v));
+        }
+    }
+
+    TEST_CASE("Recover freed pages") {
+        CrashFiles files;
+        uint64_t num_free_pages;
+        {
+            DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, true);
+            BufferPool pool(&dm, 8);
+            StaticHashing<int, int> sh(4, &pool);
+            std::vector<int> keys(2000);
+            for (int i = 0; i < 2000; ++i) {
+                keys[i] = i;
+            }
+            sh.multi_insert(keys, keys);
+            pool.sync();
+            files.keep_file();
+            // both paths which free the pages of emptied buckets
+            for (int i = 0; i < 500; ++i) {
+                sh.remove(i);
+            }
+            sh.multi_remove(std::span<const int>(keys).subspan(500, 1000));
+            pool.sync();
+            files.keep_log();
+            num_free_pages = dm.get_num_free_pages();
+            CHECK(num_free_pages > 0);
+        }
+        DiskManager dm(files.crashed, PAGE_SIZE, IoMode::Buffered, true);
+        CHECK(dm.get_num_free_pages() == num_free_pages);
+        BufferPool pool(&dm, 8);
+        StaticHashing<int, int> sh(4, &pool);
+        for (int i = 0; i < 2000; ++i) {
+            int v;
+            REQUIRE(sh.get(i, &v) == (i >= 1500));
+        }
+        // the free chain is intact, so its pages can be handed out again
+        for (int i = 0; i < 1500; ++i) {
+            REQUIRE(sh.insert(i, i));
+        }
+        CHECK(dm.get_num_free_pages() < num_free_pages);
+        for (int i = 0; i < 2000; ++i) {
+            int v;
+            REQUIRE(sh.get(i, &v));
+            REQUIRE(v == i);
+        }
+    }
+
+    TEST_CASE("Schemes without redo records") {
+        // their metadata couldn't be recovered, so they refuse a file with a log
+        CrashFiles files;
+        DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, true);
+        BufferPool pool(&dm, 8);
+        CHECK_THROWS_AS((LinearHashing<int, int>(&pool)), std::runtime_error);
+        CHECK_THROWS_AS((CuckooHashing<int, int>(4, &pool)), std::runtime_error);
+        CHECK(dm.get_root_page() == 0);
+    }
+
+    TEST_CASE("Group commit") {
+        CrashFiles files;
+        DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, true);
+        // a flush in the middle of an operation would commit part of it, so the policy is not applied
+        dm.set_sync_policy({1});
+        BufferPool pool(&dm, 4);
+        ExtendibleHashing<int, int> eh(&pool);
+        pool.sync();
+        dm.reset_stats();
+        const auto file_size = std::filesystem::file_size(files.path);
+        const auto log_size = dm.wal->size();
+        for (int i = 0; i < 2000; ++i) {
+            eh.insert(i, i);
+        }
+        CHECK(dm.num_writes > 0);
+        CHECK(dm.num_flushes == 0);
+        CHECK(dm.wal->size() == log_size);
+        pool.sync();
+        CHECK(dm.num_flushes == 1);
+        CHECK(std::filesystem::file_size(files.path) > file_size);
+        const auto committed_size = dm.wal->size();
+        CHECK(committed_size > log_size);
+
+        // the log only keeps the splits done since the directory was saved
+        dm.checkpoint();
+        CHECK(dm.wal->size() > 0);
+        CHECK(dm.wal->size() < committed_size);
+        CHECK_FALSE(dm.redo_records.empty());
+        eh.save();
+        pool.sync();
+        dm.checkpoint();
+        CHECK(dm.wal->size() == 0);
+        CHECK(dm.redo_records.empty());
+    }
+
+    TEST_CASE("Batches are committed between operations") {
+        CrashFiles files;
+        constexpr int num_keys = 20000;
+        {
+            DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, true);
+            // few frames, so that nearly every insert writes back a page
+            BufferPool pool(&dm, 4);
+            ExtendibleHashing<int, int> eh(&pool);
+            for (int i = 0; i < num_keys; ++i) {
+                eh.insert(i, i);
+            }
+            // the batch was committed without any sync()
+            CHECK(dm.num_flushes > 0);
+            // crash before the rest is committed when closing
+            files.keep_file();
+            files.keep_log();
+        }
+        DiskManager dm(files.crashed, PAGE_SIZE, IoMode::Buffered, true);
+        BufferPool pool(&dm, 8);
+        ExtendibleHashing<int, int> eh(&pool);
+        // only whole inserts were committed, so the keys recovered are the ones inserted before the last commit
+        int num_recovered = 0;
+        int v;
+        while (num_recovered < num_keys && eh.get(num_recovered, &v)) {
+            ++num_recovered;
+        }
+        CHECK(num_recovered > 0);
+        for (int i = num_recovered; i < num_keys; ++i) {
+            REQUIRE_FALSE(eh.get(i, &v));
+        }
+    }
+
+    TEST_CASE("Commit Perf") {
+        CrashFiles files;
+        constexpr int num_keys = 20000, keys_per_commit = 100;
+        bool wal = false;
+        SUBCASE("Flush every page write") {}
+        SUBCASE("Write-ahead log") {
+            wal = true;
+        }
+        DiskManager dm(files.path, PAGE_SIZE, IoMode::Buffered, wal);
+        if (!wal) {
+            dm.set_sync_policy({1});
+        }
+        BufferPool pool(&dm, 16);
+        ExtendibleHashing<int, int> eh(&pool);
+        Stopwatch sw;
+        for (int i = 0; i < num_keys; ++i) {
+            eh.insert(i, i);
+            if (i % keys_per_commit == keys_per_commit - 1) {
+                pool.sync();
+            }
+        }
+        MESSAGE("Insertion Time: ", sw.stop(), "us, flushes: ", dm.num_flushes.load());
+    }
+}